@@ -0,0 +1,663 @@
+/*
+ * Ahead-of-time translation of Mini-ELF programs to C
+ *
+ * Name: Griffin Moran
+ */
+
+#include "aot.h"
+#include "p3-disas.h"
+#include "predecode.h"
+
+/*
+Runtime shared by every translated program. exec() carries out one
+instruction exactly like decode_execute followed by memory_wb_pc (including
+their overflow, bounds and output buffer quirks) and is called with constant
+operands from the translated code, so the compiler folds it down to the few
+statements each instruction needs. Accesses outside the address space stop
+with ADR as they do there. Stores into the translated bytes raise smc,
+after which interp() runs the rest of the program from memory.
+*/
+static const char *aot_runtime[] = {
+    "#include <inttypes.h>",
+    "#include <stdbool.h>",
+    "#include <stdint.h>",
+    "#include <stdio.h>",
+    "#include <string.h>",
+    "",
+    "enum { AOK = 1, HLT, ADR, INS };",
+    "",
+    "/* same layout as y86_t: register 15 aliases the flags */",
+    "static struct {",
+    "    uint64_t reg[15];",
+    "    bool zf;",
+    "    bool sf;",
+    "    bool of;",
+    "    uint64_t pc;",
+    "    int stat;",
+    "} cpu;",
+    "",
+    "static uint64_t count;",
+    "static bool smc;",
+    "static char output[OUTSIZE + 16];",
+    "static size_t bufLen;",
+    "",
+    "static inline uint64_t rget(int r)",
+    "{",
+    "    uint64_t v;",
+    "    memcpy(&v, (unsigned char*)&cpu + 8 * r, 8);",
+    "    return v;",
+    "}",
+    "",
+    "static inline void rset(int r, uint64_t v)",
+    "{",
+    "    memcpy((unsigned char*)&cpu + 8 * r, &v, 8);",
+    "}",
+    "",
+    "static inline uint64_t ld(uint64_t a)",
+    "{",
+    "    uint64_t v = 0;",
+    "    if(a <= MEMSIZE - 8) {",
+    "        memcpy(&v, mem + a, 8);",
+    "    }",
+    "    return v;",
+    "}",
+    "",
+    "static inline void st(uint64_t a, uint64_t v, unsigned n)",
+    "{",
+    "    if(a <= MEMSIZE - n) {",
+    "        memcpy(mem + a, &v, n);",
+    "        for(unsigned i = 0; i < n; i++) {",
+    "            smc |= code[a + i] & 1;",
+    "        }",
+    "    }",
+    "}",
+    "",
+    "static inline unsigned char ldb(uint64_t a)",
+    "{",
+    "    return a < MEMSIZE ? mem[a] : 0;",
+    "}",
+    "",
+    "static inline bool cond(int ifun)",
+    "{",
+    "    switch(ifun) {",
+    "        case 1: return (cpu.sf ^ cpu.of) || cpu.zf;",
+    "        case 2: return cpu.sf ^ cpu.of;",
+    "        case 3: return cpu.zf;",
+    "        case 4: return !cpu.zf;",
+    "        case 5: return !(cpu.sf ^ cpu.of);",
+    "        case 6: return !(cpu.sf ^ cpu.of) && !cpu.zf;",
+    "        default: return true;",
+    "    }",
+    "}",
+    "",
+    "static inline uint64_t alu(int ifun, uint64_t valA, uint64_t valB, bool flags)",
+    "{",
+    "    uint64_t valE;",
+    "    bool of;",
+    "    switch(ifun) {",
+    "        case 0:",
+    "            valE = valB + valA;",
+    "            of = (((int64_t)valA < 0) == ((int64_t)valB < 0)) &&",
+    "                 (((int64_t)valE < 0) != ((int64_t)valB < 0));",
+    "            break;",
+    "        case 1:",
+    "            valE = valB - valA;",
+    "            of = ((int64_t)valA > 0 && (int64_t)valE > (int64_t)valB) ||",
+    "                 ((int64_t)valA < 0 && (int64_t)valE < (int64_t)valB);",
+    "            break;",
+    "        case 2:",
+    "            valE = valB & valA;",
+    "            of = false;",
+    "            break;",
+    "        default:",
+    "            valE = valB ^ valA;",
+    "            of = false;",
+    "            break;",
+    "    }",
+    "    if(flags) {",
+    "        cpu.zf = (int64_t)valE == 0;",
+    "        cpu.sf = (int64_t)valE < 0;",
+    "        cpu.of = of;",
+    "    }",
+    "    return valE;",
+    "}",
+    "",
+    "static inline bool load(int d, uint64_t a, uint64_t next)",
+    "{",
+    "    if(a <= MEMSIZE - 8) {",
+    "        rset(d, ld(a));",
+    "        return true;",
+    "    }",
+    "    cpu.stat = ADR;",
+    "    cpu.pc = next;",
+    "    return false;",
+    "}",
+    "",
+    "static inline bool store(uint64_t a, uint64_t v, uint64_t next)",
+    "{",
+    "    if(a <= MEMSIZE - 8) {",
+    "        st(a, v, 8);",
+    "        return true;",
+    "    }",
+    "    cpu.stat = ADR;",
+    "    cpu.pc = next;",
+    "    return false;",
+    "}",
+    "",
+    "static inline bool push(uint64_t v, uint64_t next)",
+    "{",
+    "    uint64_t a = cpu.reg[4] - 8;",
+    "    if(a > MEMSIZE - 8) {",
+    "        cpu.stat = ADR;",
+    "        cpu.pc = next;",
+    "        return false;",
+    "    }",
+    "    st(a, v, 8);",
+    "    cpu.reg[4] = a;",
+    "    return true;",
+    "}",
+    "",
+    "static inline bool pop(int d, uint64_t next)",
+    "{",
+    "    uint64_t a = cpu.reg[4];",
+    "    if(a > MEMSIZE - 8) {",
+    "        cpu.stat = ADR;",
+    "        cpu.pc = next;",
+    "        return false;",
+    "    }",
+    "    cpu.reg[4] = a + 8;",
+    "    rset(d, ld(a));",
+    "    return true;",
+    "}",
+    "",
+    "/* pop of a value known to be in register s */",
+    "static inline void popf(int d, int s)",
+    "{",
+    "    uint64_t v = cpu.reg[s];",
+    "    cpu.reg[4] += 8;",
+    "    cpu.reg[d] = v;",
+    "}",
+    "",
+    "static void trap(int ifun)",
+    "{",
+    "    uint64_t a;",
+    "    char c;",
+    "    long long n;",
+    "    switch(ifun) {",
+    "        case 0:",
+    "            if(!cpu.reg[6] || bufLen >= OUTSIZE) {",
+    "                cpu.stat = HLT;",
+    "                printf(\"I/O Error\\n\");",
+    "            } else if(cpu.reg[6] >= MEMSIZE) {",
+    "                cpu.stat = ADR;",
+    "            } else {",
+    "                snprintf(&output[bufLen], 2, \"%c\", ldb(cpu.reg[6]));",
+    "                bufLen++;",
+    "            }",
+    "            break;",
+    "        case 1:",
+    "            if(cpu.reg[7] >= MEMSIZE) {",
+    "                cpu.stat = ADR;",
+    "            } else if(scanf(\"%c\", &c) != 1) {",
+    "                cpu.stat = HLT;",
+    "                printf(\"I/O Error\\n\");",
+    "            } else {",
+    "                st(cpu.reg[7], (unsigned char)c, 1);",
+    "            }",
+    "            break;",
+    "        case 2:",
+    "            if(!cpu.reg[6] || bufLen > OUTSIZE) {",
+    "                cpu.stat = HLT;",
+    "                printf(\"I/O Error\\n\");",
+    "            } else if(cpu.reg[6] > MEMSIZE - 8) {",
+    "                cpu.stat = ADR;",
+    "            } else {",
+    "                bufLen += snprintf(&output[bufLen], OUTSIZE - bufLen, \"%lld\",",
+    "                                   (long long)ld(cpu.reg[6]));",
+    "            }",
+    "            break;",
+    "        case 3:",
+    "            if(cpu.reg[7] > MEMSIZE - 8) {",
+    "                cpu.stat = ADR;",
+    "            } else if(scanf(\"%lld\", &n) != 1) {",
+    "                cpu.stat = HLT;",
+    "                printf(\"I/O Error\\n\");",
+    "            } else {",
+    "                st(cpu.reg[7], (uint64_t)n, 8);",
+    "            }",
+    "            break;",
+    "        case 4:",
+    "            if(!cpu.reg[6] || bufLen > OUTSIZE) {",
+    "                cpu.stat = HLT;",
+    "                printf(\"I/O Error\\n\");",
+    "            } else {",
+    "                for(a = cpu.reg[6]; a < MEMSIZE && (c = ldb(a)) != 0; a++) {",
+    "                    if(bufLen < OUTSIZE) {",
+    "                        snprintf(&output[bufLen], OUTSIZE - bufLen, \"%c\", c);",
+    "                    }",
+    "                    bufLen++;",
+    "                }",
+    "                if(a >= MEMSIZE) {",
+    "                    cpu.stat = ADR;",
+    "                }",
+    "            }",
+    "            break;",
+    "        default:",
+    "            output[bufLen < OUTSIZE ? bufLen : OUTSIZE] = 0;",
+    "            printf(\"%s\", output);",
+    "            memset(output, 0, OUTSIZE);",
+    "            break;",
+    "    }",
+    "}",
+    "",
+    "/* one instruction; returns whether its condition held */",
+    "static inline bool exec(int icode, int ifun, int ra, int rb, uint64_t valC, uint64_t valP)",
+    "{",
+    "    uint64_t valA;",
+    "    uint64_t valE;",
+    "    bool cnd = false;",
+    "    count++;",
+    "    switch(icode) {",
+    "        case 0:",
+    "            cpu.stat = HLT;",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 2:",
+    "            valA = rget(ra);",
+    "            cnd = cond(ifun);",
+    "            if(cnd) {",
+    "                rset(rb, valA);",
+    "            }",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 3:",
+    "            rset(rb, valC);",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 4:",
+    "            valA = rget(ra);",
+    "            store(rget(rb) + valC, valA, valP);",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 5:",
+    "            load(ra, rget(rb) + valC, valP);",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 6:",
+    "            rset(rb, alu(ifun, rget(ra), rget(rb), true));",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 7:",
+    "            cnd = cond(ifun);",
+    "            cpu.pc = cnd ? valC : valP;",
+    "            break;",
+    "        case 8:",
+    "            valE = cpu.reg[4] - 8;",
+    "            if((int64_t)valE < 0 || valE > MEMSIZE - 8) {",
+    "                cpu.stat = ADR;",
+    "            } else {",
+    "                st(valE, valP, 8);",
+    "                cpu.reg[4] = valE;",
+    "            }",
+    "            cpu.pc = valC;",
+    "            break;",
+    "        case 9:",
+    "            valA = cpu.reg[4];",
+    "            if(valA > MEMSIZE - 8) {",
+    "                cpu.stat = ADR;",
+    "                cpu.pc = valP;",
+    "                break;",
+    "            }",
+    "            cpu.reg[4] = valA + 8;",
+    "            cpu.pc = ld(valA);",
+    "            break;",
+    "        case 10:",
+    "            push(rget(ra), valP);",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 11:",
+    "            pop(ra, valP);",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        case 12:",
+    "            trap(ifun);",
+    "            cpu.pc = valP;",
+    "            break;",
+    "        default:",
+    "            cpu.pc = valP;",
+    "            break;",
+    "    }",
+    "    return cnd;",
+    "}",
+    "",
+    "/* fetch and run from memory, with every check fetch performs, until",
+    "   the next block start while the translated code is still current */",
+    "static void interp(void)",
+    "{",
+    "    while(cpu.stat == AOK) {",
+    "        uint64_t pc = cpu.pc;",
+    "        if(pc >= MEMSIZE) {",
+    "            cpu.stat = ADR;",
+    "            return;",
+    "        }",
+    "        if(!smc && (code[pc] & 2)) {",
+    "            return;",
+    "        }",
+    "        unsigned char op = mem[pc];",
+    "        const unsigned char *d = opdesc[op];",
+    "        unsigned char regs = (d[3] & OP_REGS) ? ldb(pc + 1) : 0xFF;",
+    "        int ra = regs >> 4;",
+    "        int rb = regs & 0x0F;",
+    "        if(!(d[3] & OP_KNOWN) || !(d[3] & OP_VALID)) {",
+    "            cpu.stat = INS;",
+    "            return;",
+    "        }",
+    "        if(pc + d[1] > MEMSIZE) {",
+    "            cpu.stat = ADR;",
+    "            return;",
+    "        }",
+    "        if(((d[3] & OP_RA) && ra == 15) || ((d[3] & OP_RB) && rb == 15) ||",
+    "                ((d[3] & OP_NORA) && ra != 15) || ((d[3] & OP_NORB) && rb != 15)) {",
+    "            cpu.stat = INS;",
+    "            return;",
+    "        }",
+    "        uint64_t valC = 0;",
+    "        if(d[2]) {",
+    "            memcpy(&valC, mem + pc + d[2], 8);",
+    "        }",
+    "        exec(op >> 4, op & 0x0F, ra, rb, valC, pc + d[0]);",
+    "    }",
+    "}",
+    "",
+    "static void dump(void)",
+    "{",
+    "    static const char *status[] = { \"\", \"AOK\", \"HLT\", \"ADR\", \"INS\" };",
+    "    unsigned long long *r = (unsigned long long*)cpu.reg;",
+    "    printf(\"Y86 CPU state:\\n\");",
+    "    printf(\"    PC: %016llx   flags: Z%d S%d O%d     %s\\n\", (unsigned long long)cpu.pc,",
+    "           cpu.zf, cpu.sf, cpu.of, status[cpu.stat]);",
+    "    printf(\"  %%rax: %016llx    %%rcx: %016llx\\n\", r[0], r[1]);",
+    "    printf(\"  %%rdx: %016llx    %%rbx: %016llx\\n\", r[2], r[3]);",
+    "    printf(\"  %%rsp: %016llx    %%rbp: %016llx\\n\", r[4], r[5]);",
+    "    printf(\"  %%rsi: %016llx    %%rdi: %016llx\\n\", r[6], r[7]);",
+    "    printf(\"   %%r8: %016llx     %%r9: %016llx\\n\", r[8], r[9]);",
+    "    printf(\"  %%r10: %016llx    %%r11: %016llx\\n\", r[10], r[11]);",
+    "    printf(\"  %%r12: %016llx    %%r13: %016llx\\n\", r[12], r[13]);",
+    "    printf(\"  %%r14: %016llx\\n\", r[14]);",
+    "}",
+    NULL
+};
+
+/*
+Jump to a target known at translation time: straight to the block starting
+there, through the dispatch switch otherwise.
+*/
+static void aot_goto (ir_program_t *ir, address_t target, const char *indent)
+{
+    if(target < MEMSIZE && ir -> block[target] >= 0) {
+        printf("%sgoto L_%03" PRIx64 ";\n", indent, target);
+    } else {
+        printf("%scpu.pc = 0x%" PRIx64 "ULL;\n", indent, target);
+        printf("%sgoto dispatch;\n", indent);
+    }
+}
+
+/*
+Leave for the interpreter once a store has hit translated code.
+*/
+static void aot_smc (address_t next)
+{
+    printf("    if(smc) {\n        cpu.pc = 0x%" PRIx64 ";\n        goto interp;\n    }\n", next);
+}
+
+/*
+Emit the loaded address space, the map of translated bytes and block starts,
+and the opcode table.
+*/
+static void aot_data (byte_t *memory, ir_program_t *ir)
+{
+    byte_t code[MEMSIZE];
+    memset(code, 0, sizeof(code));
+    for(uint32_t b = 0; b < ir -> numBlocks; b++) {
+        ir_block_t *blk = &(ir -> blocks[b]);
+        for(uint32_t k = 0; k < blk -> count; k++) {
+            ir_op_t *op = &(ir -> ops[blk -> first + k]);
+            address_t span = op -> kind == IR_STOP ? 10 : op -> len;
+            for(address_t a = op -> pc; a < op -> pc + span && a < MEMSIZE; a++) {
+                code[a] |= 1;
+            }
+        }
+        code[blk -> start] |= 2;
+    }
+
+    printf("/* loaded address space */\n");
+    printf("static unsigned char mem[MEMSIZE] = {\n");
+    for(int i = 0; i < MEMSIZE; i += 16) {
+        printf("   ");
+        for(int j = i; j < i + 16; j++) {
+            printf(" 0x%02x,", memory[j]);
+        }
+        printf("\n");
+    }
+    printf("};\n\n");
+
+    printf("/* 1: byte the translated code was decoded from, 2: block start */\n");
+    printf("static const unsigned char code[MEMSIZE] = {\n");
+    for(int i = 0; i < MEMSIZE; i += 32) {
+        printf("   ");
+        for(int j = i; j < i + 32; j++) {
+            printf(" %d,", code[j]);
+        }
+        printf("\n");
+    }
+    printf("};\n\n");
+
+    printf("/* opcode table: length, bytes needed, offset of valC, flags */\n");
+    printf("static const unsigned char opdesc[256][4] = {\n");
+    for(int i = 0; i < 256; i += 4) {
+        printf("   ");
+        for(int j = i; j < i + 4; j++) {
+            const opdesc_t *op = &y86_opcodes[j];
+            printf(" {%d, %d, %d, 0x%02x},", op -> len, op -> need, op -> valC, op -> flags);
+        }
+        printf("\n");
+    }
+    printf("};\n\n");
+}
+
+/*
+Emit one IR operation. Operations that can stop the program set the PC
+themselves; the others leave it to the next exit.
+*/
+static void aot_op (ir_program_t *ir, ir_op_t *op)
+{
+    address_t next = op -> pc + op -> len;
+    bool cc = !(op -> flags & IRF_NOFLAGS);
+
+    y86_packed_t packed;
+    memset(&packed, 0, sizeof(y86_packed_t));
+    packed.op = op -> op;
+    packed.regs = op -> regs;
+    packed.valC = op -> imm;
+    packed.len = op -> len;
+    y86_inst_t ins = unpack_inst(&packed, op -> pc);
+
+    if(op -> kind == IR_STOP) {
+        printf("    /* 0x%03" PRIx64 ": invalid */\n", op -> pc);
+        printf("    cpu.pc = 0x%" PRIx64 ";\n", op -> pc);
+        printf("    cpu.stat = %s;\n", op -> fn == ADR ? "ADR" : "INS");
+        printf("    return;\n");
+        return;
+    }
+
+    printf("    /* 0x%03" PRIx64 ": ", op -> pc);
+    disassemble(&ins);
+    printf(" */\n");
+    if(op -> kind != IR_EXEC && op -> kind != IR_CALL && op -> kind != IR_RET) {
+        printf("    count++;\n");
+    }
+
+    char addr[64];
+    if(op -> a == NOREG) {
+        snprintf(addr, sizeof(addr), "0x%" PRIx64 "ULL", (uint64_t)op -> imm);
+    } else {
+        snprintf(addr, sizeof(addr), "cpu.reg[%d] + 0x%" PRIx64 "ULL", op -> a, (uint64_t)op -> imm);
+    }
+
+    switch(op -> kind) {
+        case (IR_MOVI):
+            printf("    cpu.reg[%d] = 0x%" PRIx64 "ULL;\n", op -> d, (uint64_t)op -> imm);
+            break;
+
+        case (IR_MOV):
+            printf("    cpu.reg[%d] = cpu.reg[%d];\n", op -> d, op -> a);
+            break;
+
+        case (IR_CMOV):
+            printf("    if(cond(%d)) {\n        cpu.reg[%d] = cpu.reg[%d];\n    }\n",
+                   op -> fn, op -> d, op -> a);
+            break;
+
+        case (IR_OP):
+            printf("    cpu.reg[%d] = alu(%d, cpu.reg[%d], cpu.reg[%d], %s);\n",
+                   op -> d, op -> fn, op -> a, op -> d, cc ? "true" : "false");
+            break;
+
+        case (IR_OPI):
+            printf("    cpu.reg[%d] = alu(%d, 0x%" PRIx64 "ULL, cpu.reg[%d], %s);\n",
+                   op -> d, op -> fn, (uint64_t)op -> imm, op -> d, cc ? "true" : "false");
+            break;
+
+        case (IR_SET):
+            printf("    cpu.reg[%d] = 0x%" PRIx64 "ULL;\n", op -> d, (uint64_t)op -> imm);
+            if(cc) {
+                printf("    cpu.zf = %d;\n    cpu.sf = %d;\n    cpu.of = %d;\n",
+                       (op -> fn & IR_ZF) != 0, (op -> fn & IR_SF) != 0, (op -> fn & IR_OF) != 0);
+            }
+            break;
+
+        case (IR_LOAD):
+            printf("    if(!load(%d, %s, 0x%" PRIx64 ")) {\n        return;\n    }\n", op -> d, addr, next);
+            break;
+
+        case (IR_STORE):
+            printf("    if(!store(%s, cpu.reg[%d], 0x%" PRIx64 ")) {\n        return;\n    }\n",
+                   addr, op -> d, next);
+            aot_smc(next);
+            break;
+
+        case (IR_PUSH):
+            printf("    if(!push(cpu.reg[%d], 0x%" PRIx64 ")) {\n        return;\n    }\n", op -> a, next);
+            aot_smc(next);
+            break;
+
+        case (IR_POP):
+            printf("    if(!pop(%d, 0x%" PRIx64 ")) {\n        return;\n    }\n", op -> d, next);
+            break;
+
+        case (IR_POPF):
+            printf("    popf(%d, %d);\n", op -> d, op -> a);
+            break;
+
+        case (IR_JMP):
+            aot_goto(ir, op -> imm, "    ");
+            break;
+
+        case (IR_BR):
+            printf("    if(cond(%d)) {\n", op -> fn);
+            aot_goto(ir, op -> imm, "        ");
+            printf("    }\n");
+            break;
+
+        case (IR_CALL):
+        case (IR_RET):
+        case (IR_EXEC):
+            printf("    exec(%d, %d, %d, %d, 0x%" PRIx64 "ULL, 0x%" PRIx64 ");\n", ins.icode,
+                   ins.ifun.b, ins.ra, ins.rb, (uint64_t)op -> imm, next);
+            if(ins.icode == RET) {
+                printf("    goto dispatch;\n");
+                break;
+            }
+            if(ins.icode == HALT) {
+                printf("    return;\n");
+                break;
+            }
+            printf("    if(cpu.stat != AOK) {\n        return;\n    }\n");
+            if(ins.icode == CALL || ins.icode == RMMOVQ || (ins.icode == IOTRAP &&
+                    (ins.ifun.trap == CHARIN || ins.ifun.trap == DECIN))) {
+                printf("    if(smc) {\n        goto interp;\n    }\n");
+            }
+            if(ins.icode == CALL) {
+                aot_goto(ir, op -> imm, "    ");
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool aot_emit (byte_t *memory, ir_program_t *ir, address_t entry, const char *name)
+{
+    if(memory == NULL || ir == NULL || ir -> block == NULL) {
+        return false;
+    }
+
+    printf("/* %s translated by y86 -c */\n\n", name != NULL ? name : "program");
+    printf("#define MEMSIZE %d\n", MEMSIZE);
+    printf("#define OUTSIZE 101\n");
+    printf("#define OP_KNOWN 0x%02x\n#define OP_VALID 0x%02x\n#define OP_REGS 0x%02x\n",
+           OP_KNOWN, OP_VALID, OP_REGS);
+    printf("#define OP_RA 0x%02x\n#define OP_RB 0x%02x\n#define OP_NORA 0x%02x\n#define OP_NORB 0x%02x\n\n",
+           OP_RA, OP_RB, OP_NORA, OP_NORB);
+    aot_data(memory, ir);
+    for(int i = 0; aot_runtime[i] != NULL; i++) {
+        printf("%s\n", aot_runtime[i]);
+    }
+
+    //translated code: one label per block, blocks in address order
+    printf("\nstatic void run(void)\n{\n");
+    printf("dispatch:\n");
+    printf("    if(smc) {\n        goto interp;\n    }\n");
+    printf("    switch(cpu.pc) {\n");
+    for(uint32_t b = 0; b < ir -> numBlocks; b++) {
+        address_t start = ir -> blocks[b].start;
+        printf("        case 0x%03" PRIx64 ": goto L_%03" PRIx64 ";\n", start, start);
+    }
+    printf("        default: goto interp;\n");
+    printf("    }\n");
+
+    for(uint32_t b = 0; b < ir -> numBlocks; b++) {
+        ir_block_t *blk = &(ir -> blocks[b]);
+        printf("\nL_%03" PRIx64 ":\n", blk -> start);
+        for(uint32_t k = 0; k < blk -> count; k++) {
+            aot_op(ir, &(ir -> ops[blk -> first + k]));
+        }
+
+        //fall into the next block when it is the one emitted next
+        ir_op_t *last = &(ir -> ops[blk -> first + blk -> count - 1]);
+        address_t next = last -> pc + last -> len;
+        bool falls = last -> kind != IR_JMP && last -> kind != IR_CALL && last -> kind != IR_RET &&
+                     last -> kind != IR_STOP && !(last -> kind == IR_EXEC && (last -> op >> 4) == HALT);
+        if(falls && (b + 1 == ir -> numBlocks || ir -> blocks[b + 1].start != next)) {
+            aot_goto(ir, next, "    ");
+        }
+    }
+
+    printf("\ninterp:\n");
+    printf("    interp();\n");
+    printf("    if(cpu.stat == AOK) {\n        goto dispatch;\n    }\n");
+    printf("}\n\n");
+
+    printf("int main(void)\n{\n");
+    printf("    cpu.pc = 0x%" PRIx64 "ULL;\n", entry);
+    printf("    cpu.stat = AOK;\n");
+    printf("    printf(\"Beginning execution at 0x%%04\" PRIx64 \"\\n\", (uint64_t)0x%" PRIx64 "ULL);\n",
+           entry);
+    printf("    run();\n");
+    printf("    dump();\n");
+    printf("    printf(\"Total execution count: %%\" PRIu64 \"\\n\", count);\n");
+    printf("    return 0;\n");
+    printf("}\n");
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef __CS261_AOT__
+#define __CS261_AOT__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+#include "ir.h"
+
+/**
+ * @brief Translate a loaded program into a standalone C program
+ *
+ * The C source is written to standard output. It holds the loaded address
+ * space and one labeled block of C per optimized IR block, with direct gotos
+ * for the static control flow of jumps and calls and a dispatch switch on
+ * the PC for returns and every target that is only known at run time. A
+ * small runtime implements the instructions and the I/O traps with the
+ * semantics of decode_execute and memory_wb_pc, and an interpreter built on
+ * the opcode table runs targets that are not block starts up to the next
+ * block start, and the rest of the program once it stores into its own
+ * translated code. Compiled and run, the program prints exactly what -e
+ * prints for the same input.
+ *
+ * @param memory Pointer to the beginning of the loaded Y86 address space
+ * @param ir Optimized IR of the program (see ir_build)
+ * @param entry Entry point of the program
+ * @param name Name of the Mini-ELF file, for the banner comment
+ * @returns True if the program could be translated, false otherwise
+ */
+bool aot_emit (byte_t *memory, ir_program_t *ir, address_t entry, const char *name);
+
+#endif
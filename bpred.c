@@ -0,0 +1,162 @@
+/*
+ * Branch predictor model
+ *
+ * Name: Griffin Moran
+ */
+
+#include "bpred.h"
+#include "p3-disas.h"
+
+bool bpred_parse (const char *name, bpred_model_t *model)
+{
+    if(name == NULL || model == NULL) {
+        return false;
+    }
+
+    if(strcmp(name, "nottaken") == 0) {
+        *model = BP_NOTTAKEN;
+    } else if(strcmp(name, "bimodal") == 0) {
+        *model = BP_BIMODAL;
+    } else if(strcmp(name, "gshare") == 0) {
+        *model = BP_GSHARE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void bpred_init (bpred_t *bp, bpred_model_t model)
+{
+    if(bp == NULL) {
+        return;
+    }
+    memset(bp, 0, sizeof(bpred_t));
+    bp -> model = model;
+
+    //counters start out weakly not-taken
+    memset(bp -> counters, 1, sizeof(bp -> counters));
+}
+
+bool bpred_update (bpred_t *bp, address_t pc, y86_inst_t *inst, bool cnd, address_t next)
+{
+    if(bp == NULL || inst == NULL || pc >= MEMSIZE) {
+        return false;
+    }
+
+    bpred_site_t *site = &(bp -> sites[pc]);
+    bool predicted = false;
+    bool miss = false;
+    uint32_t index = 0;
+
+    switch(inst -> icode) {
+        case (JUMP):
+            //unconditional jumps are resolved in decode and never miss
+            if((inst -> ifun).jump == JMP) {
+                return false;
+            }
+
+            //predict the direction
+            switch(bp -> model) {
+                case(BP_NOTTAKEN):
+                    predicted = false;
+                    break;
+
+                case(BP_BIMODAL):
+                    index = pc & (BP_TABLESIZE - 1);
+                    predicted = bp -> counters[index] >= 2;
+                    break;
+
+                case(BP_GSHARE):
+                    index = (pc ^ bp -> history) & (BP_TABLESIZE - 1);
+                    predicted = bp -> counters[index] >= 2;
+                    break;
+            }
+            miss = predicted != cnd;
+
+            //train the counter and the global history
+            if(bp -> model != BP_NOTTAKEN) {
+                if(cnd && bp -> counters[index] < 3) {
+                    bp -> counters[index]++;
+                } else if(!cnd && bp -> counters[index] > 0) {
+                    bp -> counters[index]--;
+                }
+            }
+            bp -> history = ((bp -> history << 1) | cnd) & (BP_TABLESIZE - 1);
+
+            site -> count++;
+            if(cnd) {
+                site -> taken++;
+            }
+            bp -> jumps++;
+            if(miss) {
+                bp -> jumpMiss++;
+            }
+            break;
+
+        case (CALL):
+            //push the return address, dropping the oldest entry on overflow
+            bp -> ras[bp -> ras_top] = inst -> valP;
+            bp -> ras_top = (bp -> ras_top + 1) % BP_RASDEPTH;
+            if(bp -> ras_count < BP_RASDEPTH) {
+                bp -> ras_count++;
+            }
+            return false;
+
+        case (RET):
+            //an empty stack cannot predict anything
+            if(bp -> ras_count == 0) {
+                miss = true;
+            } else {
+                bp -> ras_top = (bp -> ras_top + BP_RASDEPTH - 1) % BP_RASDEPTH;
+                bp -> ras_count--;
+                miss = bp -> ras[bp -> ras_top] != next;
+            }
+            site -> count++;
+            bp -> rets++;
+            if(miss) {
+                bp -> retMiss++;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    if(miss) {
+        site -> miss++;
+    }
+    site -> inst = *inst;
+    return miss;
+}
+
+void bpred_dump (bpred_t *bp)
+{
+    if(bp == NULL) {
+        return;
+    }
+
+    const char *names[] = { "nottaken", "bimodal", "gshare" };
+    uint64_t jumps = bp -> jumps;
+    uint64_t jumpMiss = bp -> jumpMiss;
+    uint64_t rets = bp -> rets;
+    uint64_t retMiss = bp -> retMiss;
+
+    printf("Branch prediction (%s):\n", names[bp -> model]);
+    for(address_t pc = 0; pc < MEMSIZE; pc++) {
+        bpred_site_t *site = &(bp -> sites[pc]);
+        if(site -> count == 0) {
+            continue;
+        }
+
+        printf("  0x%03" PRIx64 ": %8" PRIu64 " execs %8" PRIu64 " taken %8" PRIu64
+               " mispredicted (%6.2f%%) |   ", pc, site -> count, site -> taken, site -> miss,
+               100.0 * site -> miss / site -> count);
+        disassemble(&(site -> inst));
+        printf("\n");
+    }
+
+    printf("Conditional jumps: %" PRIu64 ", mispredicted %" PRIu64 " (%.2f%%)\n", jumps, jumpMiss,
+           jumps ? 100.0 * jumpMiss / jumps : 0.0);
+    printf("Returns: %" PRIu64 ", mispredicted %" PRIu64 " (%.2f%%)\n", rets, retMiss,
+           rets ? 100.0 * retMiss / rets : 0.0);
+}
@@ -0,0 +1,90 @@
+#ifndef __CS261_BPRED__
+#define __CS261_BPRED__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+
+#define BP_TABLEBITS 10
+#define BP_TABLESIZE (1 << BP_TABLEBITS)
+#define BP_RASDEPTH 16
+
+/* supported branch predictor models */
+typedef enum {
+    BP_NOTTAKEN = 0, BP_BIMODAL, BP_GSHARE
+} bpred_model_t;
+
+/* per-PC prediction statistics */
+typedef struct bpred_site {
+    uint64_t count;             // times the instruction was executed
+    uint64_t taken;             // times the branch was taken (jXX only)
+    uint64_t miss;              // times the prediction was wrong
+    y86_inst_t inst;            // instruction last executed at the PC
+} bpred_site_t;
+
+/* branch predictor state */
+typedef struct bpred {
+
+    bpred_model_t model;        // direction predictor for conditional jumps
+
+    uint8_t counters[BP_TABLESIZE];     // 2-bit saturating counters
+    uint32_t history;                   // global branch history (gshare)
+
+    address_t ras[BP_RASDEPTH]; // return-address stack fed by CALL
+    int ras_top;                // index of the next free RAS slot
+    int ras_count;              // number of valid RAS entries
+
+    bpred_site_t sites[MEMSIZE];        // statistics indexed by branch PC
+
+    uint64_t jumps;             // conditional jumps executed
+    uint64_t jumpMiss;          //   of which mispredicted
+    uint64_t rets;              // returns executed
+    uint64_t retMiss;           //   of which mispredicted
+
+} bpred_t;
+
+/**
+ * @brief Look up a branch predictor model by name
+ *
+ * @param name Model name ("nottaken", "bimodal" or "gshare")
+ * @param model Pointer to the model to be set
+ * @returns True if the name was recognized, false otherwise
+ */
+bool bpred_parse (const char *name, bpred_model_t *model);
+
+/**
+ * @brief Reset a branch predictor to its initial state
+ *
+ * @param bp Pointer to the branch predictor
+ * @param model Direction predictor to use for conditional jumps
+ */
+void bpred_init (bpred_t *bp, bpred_model_t model);
+
+/**
+ * @brief Feed the outcome of an executed instruction to the predictor
+ *
+ * @param bp Pointer to the branch predictor
+ * @param pc Address of the executed instruction
+ * @param inst Executed Y86 instruction
+ * @param cnd Condition computed by decode_execute (taken flag for jXX)
+ * @param next Address of the instruction executed next
+ * @returns True if the predictor would have mispredicted this instruction
+ */
+bool bpred_update (bpred_t *bp, address_t pc, y86_inst_t *inst, bool cnd, address_t next);
+
+/**
+ * @brief Print misprediction statistics per branch PC to standard out
+ *
+ * Each PC is shown with the instruction last executed there, and the
+ * totals count every instruction as what it was when it ran, so code
+ * written over during the run is reported as it executed.
+ *
+ * @param bp Pointer to the branch predictor
+ */
+void bpred_dump (bpred_t *bp);
+
+#endif
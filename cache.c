@@ -0,0 +1,265 @@
+/*
+ * Persistent cache of validated and pre-decoded images
+ *
+ * Name: Griffin Moran
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+
+#define ALIGN8(x) (((x) + 7) & ~(size_t)7)
+
+/*
+Build the path of the cache entry for a content hash.
+*/
+static void cache_path (const char *dir, uint64_t hash, char *path, size_t len)
+{
+    snprintf(path, len, "%s/%016" PRIx64 ".y86c", dir, hash);
+}
+
+/*
+Fill in the section offsets of a cache header and return the total entry size.
+*/
+static size_t cache_layout (cache_hdr_t *hdr)
+{
+    size_t off = ALIGN8(sizeof(cache_hdr_t));
+
+    hdr -> phdrOff = off;
+    off = ALIGN8(off + hdr -> hdr.e_num_phdr * sizeof(elf_phdr_t));
+    hdr -> phdr2Off = off;
+    if(hdr -> hdr2.e_version == 2) {
+        off = ALIGN8(off + hdr -> hdr2.e_num_phdr * sizeof(elf_phdr2_t));
+    }
+    hdr -> memOff = off;
+    off = ALIGN8(off + MEMSIZE);
+    hdr -> slotOff = off;
+    off = ALIGN8(off + MEMSIZE * sizeof(int32_t));
+    hdr -> instOff = off;
+    off = ALIGN8(off + hdr -> instCount * sizeof(y86_packed_t));
+    hdr -> symOff = off;
+    return off + hdr -> symSize;
+}
+
+/*
+Check every field of a mapped entry the loader and the engine index with, so
+that a corrupt entry is a miss rather than an out-of-bounds access; the
+layout has already been matched against the size of the mapping.
+*/
+static bool cache_sane (cache_hdr_t *hdr, byte_t *base, size_t size)
+{
+    if(hdr -> codeLo > hdr -> codeHi || hdr -> codeHi > MEMSIZE ||
+            hdr -> instOff > size || hdr -> instCount > (size - hdr -> instOff) / sizeof(y86_packed_t)) {
+        return false;
+    }
+
+    //segments must lie in the address space, as image_parse makes sure
+    elf_phdr_t *phdrs = (elf_phdr_t*)(base + hdr -> phdrOff);
+    for(int i = 0; i < hdr -> hdr.e_num_phdr; i++) {
+        if(phdrs[i].p_vaddr > MEMSIZE || phdrs[i].p_size > MEMSIZE - phdrs[i].p_vaddr) {
+            return false;
+        }
+    }
+    if(hdr -> hdr2.e_version == 2) {
+        elf_phdr2_t *phdrs2 = (elf_phdr2_t*)(base + hdr -> phdr2Off);
+        if(hdr -> hdr2.e_num_phdr != hdr -> hdr.e_num_phdr) {
+            return false;
+        }
+        for(int i = 0; i < hdr -> hdr2.e_num_phdr; i++) {
+            if(phdrs2[i].p_vaddr > MEMSIZE || phdrs2[i].p_size > MEMSIZE - phdrs2[i].p_vaddr) {
+                return false;
+            }
+        }
+    }
+
+    //every slot names a decoded instruction or none, and only inside the
+    //covered range
+    int32_t *slot = (int32_t*)(base + hdr -> slotOff);
+    for(address_t a = 0; a < MEMSIZE; a++) {
+        if(slot[a] < -1 || (slot[a] >= 0 && ((uint32_t)slot[a] >= hdr -> instCount ||
+                                             a < hdr -> codeLo || a >= hdr -> codeHi))) {
+            return false;
+        }
+    }
+
+    //instructions are at most ten bytes and either verified or invalid
+    y86_packed_t *insts = (y86_packed_t*)(base + hdr -> instOff);
+    for(uint32_t i = 0; i < hdr -> instCount; i++) {
+        if(insts[i].len > 10 || (insts[i].stat == 0 && insts[i].len == 0) ||
+                (insts[i].stat != 0 && insts[i].stat != ADR && insts[i].stat != INS)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t cache_hash (const byte_t *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool cache_lookup (const char *dir, elf_image_t *img, cache_t *entry)
+{
+    if(dir == NULL || img == NULL || img -> data == NULL || entry == NULL) {
+        return false;
+    }
+    memset(entry, 0, sizeof(cache_t));
+
+    uint64_t hash = cache_hash(img -> data, img -> size);
+    char path[4096];
+    cache_path(dir, hash, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(cache_hdr_t)) {
+        close(fd);
+        return false;
+    }
+
+    //private writable mapping: the engine patches the slot table in place
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        return false;
+    }
+
+    //the entry must belong to this exact file and this build, and a
+    //truncated or corrupt one is a miss
+    cache_hdr_t *hdr = (cache_hdr_t*)map;
+    cache_hdr_t expect = *hdr;
+    if(hdr -> magic != CACHE_MAGIC || hdr -> version != CACHE_VERSION ||
+            hdr -> instSize != sizeof(y86_packed_t) || hdr -> hash != hash ||
+            hdr -> fileSize != img -> size || cache_layout(&expect) != (size_t)st.st_size ||
+            memcmp(&expect, hdr, sizeof(cache_hdr_t)) != 0 ||
+            !cache_sane(hdr, (byte_t*)map, st.st_size)) {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    byte_t *base = (byte_t*)map;
+    entry -> map = map;
+    entry -> size = st.st_size;
+    entry -> hdr = hdr;
+    entry -> phdrs = (elf_phdr_t*)(base + hdr -> phdrOff);
+    if(hdr -> hdr2.e_version == 2) {
+        entry -> phdrs2 = (elf_phdr2_t*)(base + hdr -> phdr2Off);
+    }
+    entry -> memory = base + hdr -> memOff;
+    entry -> slot = (int32_t*)(base + hdr -> slotOff);
+    entry -> insts = (y86_packed_t*)(base + hdr -> instOff);
+    entry -> symbols = base + hdr -> symOff;
+    return true;
+}
+
+void cache_decoded (cache_t *entry, y86_decoded_t *prog)
+{
+    if(entry == NULL || entry -> hdr == NULL || prog == NULL) {
+        return;
+    }
+    memset(prog, 0, sizeof(y86_decoded_t));
+    prog -> insts = entry -> insts;
+    prog -> count = entry -> hdr -> instCount;
+    prog -> slot = entry -> slot;
+    prog -> lo = entry -> hdr -> codeLo;
+    prog -> hi = entry -> hdr -> codeHi;
+    prog -> owned = false;
+    for(uint32_t i = 0; i < prog -> count; i++) {
+        if(prog -> insts[i].stat != 0) {
+            prog -> invalid++;
+        }
+    }
+}
+
+bool cache_store (const char *dir, elf_image_t *img, byte_t *memory, y86_decoded_t *prog)
+{
+    if(dir == NULL || img == NULL || img -> data == NULL || memory == NULL || prog == NULL) {
+        return false;
+    }
+
+    cache_hdr_t hdr;
+    memset(&hdr, 0, sizeof(cache_hdr_t));
+    hdr.magic = CACHE_MAGIC;
+    hdr.version = CACHE_VERSION;
+    hdr.hash = cache_hash(img -> data, img -> size);
+    hdr.fileSize = img -> size;
+    hdr.instSize = sizeof(y86_packed_t);
+    hdr.instCount = prog -> count;
+    hdr.codeLo = prog -> lo;
+    hdr.codeHi = prog -> hi;
+    hdr.hdr = img -> hdr;
+    hdr.hdr2 = img -> hdr2;
+
+    //the symbol and string tables run from the first of them to the end of the file
+    uint64_t symStart = img -> hdr2.e_symtab;
+    if(img -> hdr2.e_strtab != 0 && (symStart == 0 || img -> hdr2.e_strtab < symStart)) {
+        symStart = img -> hdr2.e_strtab;
+    }
+    if(symStart != 0 && symStart < img -> size) {
+        hdr.symSize = img -> size - symStart;
+    }
+
+    size_t size = cache_layout(&hdr);
+    byte_t *buffer = (byte_t*)calloc(size, 1);
+    if(buffer == NULL) {
+        return false;
+    }
+
+    memcpy(buffer, &hdr, sizeof(cache_hdr_t));
+    memcpy(buffer + hdr.phdrOff, img -> phdrs, hdr.hdr.e_num_phdr * sizeof(elf_phdr_t));
+    if(img -> phdrs2 != NULL) {
+        memcpy(buffer + hdr.phdr2Off, img -> phdrs2, hdr.hdr2.e_num_phdr * sizeof(elf_phdr2_t));
+    }
+    memcpy(buffer + hdr.memOff, memory, MEMSIZE);
+    memcpy(buffer + hdr.slotOff, prog -> slot, MEMSIZE * sizeof(int32_t));
+    memcpy(buffer + hdr.instOff, prog -> insts, prog -> count * sizeof(y86_packed_t));
+    if(hdr.symSize > 0) {
+        memcpy(buffer + hdr.symOff, img -> data + symStart, hdr.symSize);
+    }
+
+    //write a private temporary file and rename it so readers never see
+    //a partial entry
+    char path[4096];
+    char temp[4096 + 32];
+    cache_path(dir, hdr.hash, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid());
+
+    mkdir(dir, 0777);
+    FILE *file = fopen(temp, "wb");
+    if(file == NULL) {
+        free(buffer);
+        return false;
+    }
+
+    bool ok = fwrite(buffer, size, 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    free(buffer);
+
+    if(!ok || rename(temp, path) != 0) {
+        remove(temp);
+        return false;
+    }
+    return true;
+}
+
+void cache_close (cache_t *entry)
+{
+    if(entry == NULL || entry -> map == NULL) {
+        return;
+    }
+    munmap(entry -> map, entry -> size);
+    memset(entry, 0, sizeof(cache_t));
+}
@@ -0,0 +1,124 @@
+#ifndef __CS261_CACHE__
+#define __CS261_CACHE__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "y86.h"
+#include "image.h"
+#include "engine.h"
+
+#define CACHE_MAGIC 0x43363859      /* "Y86C" */
+#define CACHE_VERSION 4
+
+/*
+   Cache entry file format (all sections 8-byte aligned, offsets from the
+   start of the file):
+   +----------------------------------------------+
+   | header (cache_hdr_t)                         |
+   +----------------------------------------------+
+   | program headers (elf_phdr_t)                 |
+   +----------------------------------------------+
+   | version 2 program headers (elf_phdr2_t)      |
+   +----------------------------------------------+
+   | loaded address space - MEMSIZE bytes         |
+   +----------------------------------------------+
+   | slot table - MEMSIZE int32_t entries         |
+   +----------------------------------------------+
+   | decoded instructions (y86_packed_t)          |
+   +----------------------------------------------+
+   | symbol and string tables (raw file bytes)    |
+   +----------------------------------------------+
+
+   Entries are named after the content hash of the Mini-ELF file, so the
+   whole file can be mapped and used in place without any parsing.
+*/
+typedef struct cache_hdr {
+    uint32_t magic;             /* CACHE_MAGIC */
+    uint32_t version;           /* CACHE_VERSION */
+    uint64_t hash;              /* content hash of the Mini-ELF file */
+    uint64_t fileSize;          /* size of the Mini-ELF file */
+    uint32_t instSize;          /* sizeof(y86_packed_t) of the writer */
+    uint32_t instCount;         /* number of decoded instructions */
+    uint64_t codeLo;            /* address range covered by the decoded */
+    uint64_t codeHi;            /*   instructions */
+    uint32_t phdrOff;           /* section offsets */
+    uint32_t phdr2Off;          /*   (no version 2 headers for version 1) */
+    uint32_t memOff;
+    uint32_t slotOff;
+    uint32_t instOff;
+    uint32_t symOff;
+    uint32_t symSize;
+    uint32_t reserved;
+    elf_hdr_t hdr;              /* validated file header */
+    elf_hdr2_t hdr2;            /* full-width file header */
+} cache_hdr_t;
+
+/* a mapped cache entry */
+typedef struct cache {
+    void *map;                  // the mapped entry file
+    size_t size;                // size of the mapping
+    cache_hdr_t *hdr;           // header at the start of the mapping
+    elf_phdr_t *phdrs;          // sections inside the mapping
+    elf_phdr2_t *phdrs2;        //   (NULL for version 1 images)
+    byte_t *memory;
+    int32_t *slot;
+    y86_packed_t *insts;
+    byte_t *symbols;
+} cache_t;
+
+/**
+ * @brief Compute the content hash (64-bit FNV-1a) used to name cache entries
+ *
+ * @param data Bytes to hash
+ * @param size Number of bytes
+ * @returns Hash value
+ */
+uint64_t cache_hash (const byte_t *data, size_t size);
+
+/**
+ * @brief Look up and map the cache entry for an image
+ *
+ * Besides the header, the code range, the segments, every slot and every
+ * decoded instruction are bounds-checked, so a truncated or corrupt entry
+ * is a miss and the image is parsed and decoded again.
+ *
+ * @param dir Cache directory
+ * @param img Image whose raw bytes are used as the key (need not be parsed)
+ * @param entry Pointer to the entry to be populated on a hit
+ * @returns True on a hit with a consistent entry, false otherwise
+ */
+bool cache_lookup (const char *dir, elf_image_t *img, cache_t *entry);
+
+/**
+ * @brief Point a decoded program at the instructions held by a cache entry
+ *
+ * @param entry Mapped cache entry
+ * @param prog Decoded program to be populated (not owned; valid until
+ * cache_close)
+ */
+void cache_decoded (cache_t *entry, y86_decoded_t *prog);
+
+/**
+ * @brief Write the cache entry for a validated and loaded image
+ *
+ * @param dir Cache directory
+ * @param img Validated image
+ * @param memory Address space right after loading the image
+ * @param prog Decoded program for the loaded image
+ * @returns True if the entry was written, false otherwise
+ */
+bool cache_store (const char *dir, elf_image_t *img, byte_t *memory, y86_decoded_t *prog);
+
+/**
+ * @brief Unmap a cache entry
+ *
+ * @param entry Entry to unmap
+ */
+void cache_close (cache_t *entry);
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Checkpoints of a running program
+ *
+ * Name: Griffin Moran
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "ckpt.h"
+#include "cache.h"
+
+/* set by SIGUSR1, cleared once the checkpoint is taken */
+static volatile sig_atomic_t ckptRequested = 0;
+
+static struct sigaction ckptSaved;
+
+static void ckpt_signal (int sig)
+{
+    (void)sig;
+    ckptRequested = 1;
+}
+
+/*
+Write the shadow to the checkpoint file through a temporary file, so that
+the previous checkpoint stays intact until the new one is complete.
+*/
+static bool ckpt_write (ckpt_t *ck)
+{
+    char temp[4096 + 32];
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", ck -> path, (long)getpid());
+    FILE *file = fopen(temp, "wb");
+    if(file == NULL) {
+        return false;
+    }
+
+    //only pages that are not all zeros are kept
+    ckpt_page_t pages[NUMPAGES];
+    uint32_t n = 0;
+    for(uint32_t p = 0; p < NUMPAGES; p++) {
+        byte_t *data = ck -> shadow + ((address_t)p << PAGEBITS);
+        for(int i = 0; i < PAGESIZE; i++) {
+            if(data[i] != 0) {
+                pages[n].page = p;
+                memcpy(pages[n].data, data, PAGESIZE);
+                n++;
+                break;
+            }
+        }
+    }
+    ck -> hdr.numPages = n;
+
+    bool ok = fwrite(&(ck -> hdr), sizeof(ckpt_hdr_t), 1, file) == 1;
+    if(n > 0) {
+        ok = fwrite(pages, sizeof(ckpt_page_t), n, file) == n && ok;
+    }
+    ok = (fclose(file) == 0) && ok;
+
+    if(!ok || rename(temp, ck -> path) != 0) {
+        remove(temp);
+        return false;
+    }
+    return true;
+}
+
+/*
+Writer thread: sleeps until the engine hands over a checkpoint.
+*/
+static void *ckpt_writer (void *arg)
+{
+    ckpt_t *ck = (ckpt_t*)arg;
+
+    pthread_mutex_lock(&(ck -> lock));
+    while(true) {
+        while(!ck -> busy && !ck -> quit) {
+            pthread_cond_wait(&(ck -> wake), &(ck -> lock));
+        }
+        if(!ck -> busy) {
+            break;
+        }
+
+        //hdr and shadow are ours until busy is cleared
+        pthread_mutex_unlock(&(ck -> lock));
+        bool ok = ckpt_write(ck);
+        pthread_mutex_lock(&(ck -> lock));
+
+        if(!ok) {
+            ck -> failed++;
+        }
+        ck -> busy = false;
+    }
+    pthread_mutex_unlock(&(ck -> lock));
+    return NULL;
+}
+
+/*
+Engine tick: take a checkpoint when one is due and the writer is idle.
+*/
+static void ckpt_tick (void *arg, engine_t *eng)
+{
+    ckpt_t *ck = (ckpt_t*)arg;
+    bool periodic = ck -> every != 0 && eng -> count >= ck -> nextAt;
+
+    //the next tick is the next periodic checkpoint or the next signal poll
+    uint64_t next = eng -> count + CKPT_POLL;
+    if(ck -> every != 0) {
+        if(periodic) {
+            ck -> nextAt = eng -> count + ck -> every;
+        }
+        if(ck -> nextAt < next) {
+            next = ck -> nextAt;
+        }
+    }
+    eng -> tickAt = next;
+
+    if(!periodic && !ckptRequested) {
+        return;
+    }
+
+    pthread_mutex_lock(&(ck -> lock));
+    bool busy = ck -> busy;
+    pthread_mutex_unlock(&(ck -> lock));
+    if(busy) {
+        //still writing the previous one; try again at the next poll
+        ckptRequested = 1;
+        return;
+    }
+    ckptRequested = 0;
+
+    //copy only what changed since the last checkpoint
+    y86_mem_t *mem = ck -> mem;
+    for(uint32_t p = 0; p < NUMPAGES; p++) {
+        if(mem -> page[p] & PG_DIRTY) {
+            address_t a = (address_t)p << PAGEBITS;
+            memcpy(ck -> shadow + a, eng -> memory + a, PAGESIZE);
+        }
+    }
+    mem_clean(mem);
+
+    y86_io_t *io = io_current;
+    ck -> hdr.count = eng -> count;
+    ck -> hdr.cpu = *(eng -> cpu);
+    ck -> hdr.written = io -> written;
+    ck -> hdr.inputPos = io -> inputPos;
+    ck -> hdr.bufLen = io -> bufLen;
+    memcpy(ck -> hdr.output, io -> output, sizeof(ck -> hdr.output));
+
+    pthread_mutex_lock(&(ck -> lock));
+    ck -> busy = true;
+    ck -> taken++;
+    pthread_cond_signal(&(ck -> wake));
+    pthread_mutex_unlock(&(ck -> lock));
+}
+
+bool ckpt_start (ckpt_t *ck, const char *path, elf_image_t *img, engine_t *eng, uint64_t every)
+{
+    if(ck == NULL || path == NULL || img == NULL || img -> data == NULL || eng == NULL ||
+            mem_current == NULL) {
+        return false;
+    }
+    memset(ck, 0, sizeof(ckpt_t));
+    ck -> path = path;
+    ck -> every = every;
+    ck -> nextAt = eng -> count + every;
+    ck -> mem = mem_current;
+
+    ck -> hdr.magic = CKPT_MAGIC;
+    ck -> hdr.version = CKPT_VERSION;
+    ck -> hdr.hash = cache_hash(img -> data, img -> size);
+    ck -> hdr.fileSize = img -> size;
+    ck -> hdr.cpuSize = sizeof(y86_t);
+    ck -> hdr.pageSize = PAGESIZE;
+
+    //the shadow starts as the whole address space; from then on the page
+    //table's dirty bits say which pages to copy
+    mem_fault_all(ck -> mem);
+    memcpy(ck -> shadow, eng -> memory, MEMSIZE);
+    mem_clean(ck -> mem);
+
+    pthread_mutex_init(&(ck -> lock), NULL);
+    pthread_cond_init(&(ck -> wake), NULL);
+    if(pthread_create(&(ck -> writer), NULL, ckpt_writer, ck) != 0) {
+        pthread_cond_destroy(&(ck -> wake));
+        pthread_mutex_destroy(&(ck -> lock));
+        return false;
+    }
+    ck -> started = true;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = ckpt_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, &ckptSaved);
+
+    engine_tick(eng, ckpt_tick, ck, every != 0 && every < CKPT_POLL ? every : CKPT_POLL);
+    return true;
+}
+
+void ckpt_stop (ckpt_t *ck)
+{
+    if(ck == NULL || !ck -> started) {
+        return;
+    }
+    sigaction(SIGUSR1, &ckptSaved, NULL);
+
+    pthread_mutex_lock(&(ck -> lock));
+    ck -> quit = true;
+    pthread_cond_signal(&(ck -> wake));
+    pthread_mutex_unlock(&(ck -> lock));
+    pthread_join(ck -> writer, NULL);
+
+    pthread_cond_destroy(&(ck -> wake));
+    pthread_mutex_destroy(&(ck -> lock));
+    ck -> started = false;
+}
+
+bool ckpt_restore (const char *path, elf_image_t *img, byte_t *memory, y86_t *cpu,
+                   uint64_t *count)
+{
+    if(path == NULL || img == NULL || img -> data == NULL || memory == NULL || cpu == NULL ||
+            count == NULL) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if(file == NULL) {
+        return false;
+    }
+
+    //the checkpoint must belong to this exact file and this build
+    ckpt_hdr_t hdr;
+    if(fread(&hdr, sizeof(ckpt_hdr_t), 1, file) != 1 || hdr.magic != CKPT_MAGIC ||
+            hdr.version != CKPT_VERSION || hdr.cpuSize != sizeof(y86_t) ||
+            hdr.pageSize != PAGESIZE || hdr.numPages > NUMPAGES ||
+            hdr.hash != cache_hash(img -> data, img -> size) || hdr.fileSize != img -> size) {
+        fclose(file);
+        return false;
+    }
+
+    ckpt_page_t pages[NUMPAGES];
+    if(fread(pages, sizeof(ckpt_page_t), hdr.numPages, file) != hdr.numPages) {
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+    for(uint32_t i = 0; i < hdr.numPages; i++) {
+        if(pages[i].page >= NUMPAGES) {
+            return false;
+        }
+    }
+
+    memset(memory, 0, MEMSIZE);
+    for(uint32_t i = 0; i < hdr.numPages; i++) {
+        memcpy(memory + (pages[i].page << PAGEBITS), pages[i].data, PAGESIZE);
+    }
+    *cpu = hdr.cpu;
+    *count = hdr.count;
+
+    y86_io_t *io = io_current;
+    io -> written = hdr.written;
+    io -> inputPos = hdr.inputPos <= io -> inputLen ? hdr.inputPos : io -> inputLen;
+    io -> bufLen = hdr.bufLen;
+    memcpy(io -> output, hdr.output, sizeof(io -> output));
+    return true;
+}
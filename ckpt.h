@@ -0,0 +1,130 @@
+#ifndef __CS261_CKPT__
+#define __CS261_CKPT__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "elf.h"
+#include "y86.h"
+#include "image.h"
+#include "engine.h"
+#include "mem.h"
+#include "io.h"
+
+#define CKPT_MAGIC 0x4b363859       /* "Y86K" */
+#define CKPT_VERSION 1
+
+/* instructions between two looks for a SIGUSR1 request */
+#define CKPT_POLL ENGINE_QUANTUM
+
+/*
+   Checkpoint file format:
+   +----------------------------------------------+
+   | header (ckpt_hdr_t)                          |
+   +----------------------------------------------+
+   | pages (ckpt_page_t), one per page of the     |
+   | address space that is not all zeros          |
+   +----------------------------------------------+
+
+   A checkpoint belongs to the Mini-ELF file it was taken from (by content
+   hash) and to the build that wrote it (by structure sizes). Standard
+   input is not part of it: a restored run reads on from its own input.
+*/
+typedef struct ckpt_hdr {
+    uint32_t magic;             /* CKPT_MAGIC */
+    uint32_t version;           /* CKPT_VERSION */
+    uint64_t hash;              /* content hash of the Mini-ELF file */
+    uint64_t fileSize;          /* size of the Mini-ELF file */
+    uint32_t cpuSize;           /* sizeof(y86_t) of the writer */
+    uint32_t pageSize;          /* PAGESIZE of the writer */
+    uint32_t numPages;          /* number of pages that follow */
+    uint32_t reserved;
+    uint64_t count;             /* instructions retired */
+    uint64_t written;           /* buffered output dropped so far */
+    uint64_t inputPos;          /* buffered input consumed so far */
+    uint64_t bufLen;            /* I/O trap buffer */
+    char output[IO_BUFSIZE + 1];
+    y86_t cpu;                  /* CPU state */
+} ckpt_hdr_t;
+
+/* one page of the address space */
+typedef struct ckpt_page {
+    uint64_t page;              /* page number */
+    byte_t data[PAGESIZE];      /* its contents */
+} ckpt_page_t;
+
+/* periodic checkpoints of a running engine
+
+   The engine only ever copies the pages written since the previous
+   checkpoint into a shadow of the address space; a writer thread turns
+   the shadow into the file. A checkpoint that falls due while the previous
+   one is still being written is taken at the next poll instead. */
+typedef struct ckpt {
+
+    const char *path;           // checkpoint file
+    uint64_t hash;              // content hash of the Mini-ELF file
+    uint64_t fileSize;          // size of the Mini-ELF file
+    uint64_t every;             // instructions between checkpoints (0 for none)
+    uint64_t nextAt;            // count of the next periodic checkpoint
+
+    y86_mem_t *mem;             // page table tracking dirty pages
+    ckpt_hdr_t hdr;             // state saved by the last checkpoint
+    byte_t shadow[MEMSIZE];     // memory saved by the last checkpoint
+
+    pthread_t writer;           // thread writing the files
+    pthread_mutex_t lock;       // protects busy and quit
+    pthread_cond_t wake;        // signals a new checkpoint or quit
+    bool busy;                  // the writer owns hdr and shadow
+    bool quit;                  // the writer exits once idle
+    bool started;               // writer is running
+
+    uint64_t taken;             // checkpoints handed to the writer
+    uint64_t failed;            // checkpoints that could not be written
+
+} ckpt_t;
+
+/**
+ * @brief Start taking checkpoints of a running engine
+ *
+ * A checkpoint is taken every so many instructions and whenever the
+ * process receives SIGUSR1 (noticed within CKPT_POLL instructions). Every
+ * page is brought in first, since the shadow starts as a full copy of the
+ * address space.
+ *
+ * @param ck Pointer to the checkpoint state
+ * @param path File to write; it is replaced atomically by every checkpoint
+ * @param img Image of the running program
+ * @param eng Engine to take checkpoints of (its CPU, memory and count)
+ * @param every Instructions between two checkpoints (0 for SIGUSR1 only)
+ * @returns True if the writer thread could be started, false otherwise
+ */
+bool ckpt_start (ckpt_t *ck, const char *path, elf_image_t *img, engine_t *eng, uint64_t every);
+
+/**
+ * @brief Wait for the last checkpoint to be written and stop the writer
+ *
+ * @param ck Pointer to the checkpoint state
+ */
+void ckpt_stop (ckpt_t *ck);
+
+/**
+ * @brief Restore the state saved by a checkpoint
+ *
+ * The trap buffer and buffered I/O positions go to io_current.
+ *
+ * @param path Checkpoint file
+ * @param img Image of the program the checkpoint must belong to
+ * @param memory Address space to overwrite
+ * @param cpu CPU to overwrite
+ * @param count Retired instruction count to overwrite
+ * @returns True if the checkpoint was restored, false if it could not be
+ * read or belongs to another program or build (nothing is changed then)
+ */
+bool ckpt_restore (const char *path, elf_image_t *img, byte_t *memory, y86_t *cpu,
+                   uint64_t *count);
+
+#endif
@@ -0,0 +1,523 @@
+/*
+ * Reverse-capable debugger built on snapshots and re-execution
+ *
+ * Name: Griffin Moran
+ */
+
+#include "debug.h"
+#include "p2-load.h"
+#include "p3-disas.h"
+#include "p4-interp.h"
+
+/*
+Take a snapshot of the engine: its CPU, count and I/O position, and the
+pages written since the previous snapshot.
+*/
+static bool debug_snap (debug_t *dbg)
+{
+    if(dbg -> numSnaps == dbg -> capSnaps) {
+        uint32_t cap = dbg -> capSnaps > 0 ? dbg -> capSnaps * 2 : 64;
+        debug_snap_t *snaps = (debug_snap_t*)realloc(dbg -> snaps, cap * sizeof(debug_snap_t));
+        if(snaps == NULL) {
+            dbg -> failed = true;
+            return false;
+        }
+        dbg -> snaps = snaps;
+        dbg -> capSnaps = cap;
+    }
+
+    y86_mem_t *mem = dbg -> mem;
+    uint32_t n = 0;
+    for(uint32_t p = 0; p < NUMPAGES; p++) {
+        if(mem -> page[p] & PG_DIRTY) {
+            n++;
+        }
+    }
+
+    debug_snap_t *snap = &(dbg -> snaps[dbg -> numSnaps]);
+    memset(snap, 0, sizeof(debug_snap_t));
+    if(n > 0) {
+        snap -> pages = (uint8_t*)malloc(n);
+        snap -> data = (byte_t*)malloc((size_t)n * PAGESIZE);
+        if(snap -> pages == NULL || snap -> data == NULL) {
+            free(snap -> pages);
+            free(snap -> data);
+            dbg -> failed = true;
+            return false;
+        }
+    }
+    for(uint32_t p = 0; p < NUMPAGES; p++) {
+        if(mem -> page[p] & PG_DIRTY) {
+            snap -> pages[snap -> numPages] = (uint8_t)p;
+            memcpy(snap -> data + (size_t)snap -> numPages * PAGESIZE,
+                   dbg -> eng -> memory + ((address_t)p << PAGEBITS), PAGESIZE);
+            snap -> numPages++;
+        }
+    }
+    mem_clean(mem);
+
+    snap -> count = dbg -> eng -> count;
+    snap -> cpu = *(dbg -> eng -> cpu);
+    io_mark(io_current, &(snap -> io));
+    dbg -> numSnaps++;
+    return true;
+}
+
+/*
+Engine tick: snapshots are taken at multiples of the interval, and only
+beyond the last one (history that runs again already has its snapshots).
+*/
+static void debug_tick (void *arg, engine_t *eng)
+{
+    debug_t *dbg = (debug_t*)arg;
+    eng -> tickAt = (eng -> count / dbg -> every + 1) * dbg -> every;
+    if(!dbg -> failed && eng -> count > dbg -> snaps[dbg -> numSnaps - 1].count) {
+        debug_snap(dbg);
+    }
+}
+
+/*
+Index of the last snapshot taken at or before a count.
+*/
+static uint32_t debug_find (debug_t *dbg, uint64_t count)
+{
+    uint32_t k = dbg -> numSnaps - 1;
+    while(k > 0 && dbg -> snaps[k].count > count) {
+        k--;
+    }
+    return k;
+}
+
+/*
+Put the engine back in the state of a snapshot.
+*/
+static void debug_restore (debug_t *dbg, uint32_t k)
+{
+    engine_t *eng = dbg -> eng;
+    y86_mem_t *mem = dbg -> mem;
+    bool seen[NUMPAGES];
+    uint32_t left = NUMPAGES;
+    memset(seen, 0, sizeof(seen));
+
+    //the newest copy of every page at or before the snapshot
+    for(int64_t j = k; j >= 0 && left > 0; j--) {
+        debug_snap_t *snap = &(dbg -> snaps[j]);
+        for(uint32_t i = 0; i < snap -> numPages; i++) {
+            uint32_t p = snap -> pages[i];
+            if(seen[p]) {
+                continue;
+            }
+            seen[p] = true;
+            left--;
+
+            address_t a = (address_t)p << PAGEBITS;
+            byte_t *data = snap -> data + (size_t)i * PAGESIZE;
+            if(memcmp(eng -> memory + a, data, PAGESIZE) != 0) {
+                memcpy(eng -> memory + a, data, PAGESIZE);
+                if((mem -> page[p] & PG_CODE) && mem -> onCode != NULL) {
+                    mem -> onCode(mem -> onCodeArg, a, PAGESIZE);
+                }
+            }
+        }
+    }
+
+    //the next snapshot must hold every page that may differ from the last
+    for(uint32_t p = 0; p < NUMPAGES; p++) {
+        mem -> page[p] |= PG_DIRTY;
+    }
+
+    debug_snap_t *snap = &(dbg -> snaps[k]);
+    *(eng -> cpu) = snap -> cpu;
+    eng -> count = snap -> count;
+    io_rewind(io_current, &(snap -> io));
+
+    //nothing the engine remembers about the old path applies any more
+    eng -> predicted = -1;
+    eng -> rasTop = 0;
+    eng -> watchHit = false;
+    eng -> tickAt = (eng -> count / dbg -> every + 1) * dbg -> every;
+    engine_resume(eng);
+}
+
+/*
+Run forward at full speed until a count (0 for no limit), a break or a
+watched store; output of history that ran before is dropped.
+*/
+static void debug_forward (debug_t *dbg, uint64_t count)
+{
+    engine_t *eng = dbg -> eng;
+    io_current -> quietUntil = dbg -> highWater;
+    engine_limits(eng, count, 0);
+    engine_run(eng);
+    if(eng -> count > dbg -> highWater) {
+        dbg -> highWater = eng -> count;
+    }
+}
+
+bool debug_init (debug_t *dbg, engine_t *eng, uint64_t every)
+{
+    if(dbg == NULL) {
+        return false;
+    }
+    memset(dbg, 0, sizeof(debug_t));
+    if(eng == NULL || mem_current == NULL || every == 0) {
+        return false;
+    }
+    dbg -> eng = eng;
+    dbg -> mem = mem_current;
+    dbg -> every = every;
+    dbg -> highWater = eng -> count;
+
+    //the first snapshot holds the whole address space
+    mem_fault_all(dbg -> mem);
+    for(uint32_t p = 0; p < NUMPAGES; p++) {
+        dbg -> mem -> page[p] |= PG_DIRTY;
+    }
+    if(!debug_snap(dbg)) {
+        debug_free(dbg);
+        return false;
+    }
+    engine_tick(eng, debug_tick, dbg, every);
+    eng -> tickAt = (eng -> count / every + 1) * every;
+    engine_resume(eng);
+    return true;
+}
+
+void debug_free (debug_t *dbg)
+{
+    if(dbg == NULL) {
+        return;
+    }
+    for(uint32_t k = 0; k < dbg -> numSnaps; k++) {
+        free(dbg -> snaps[k].pages);
+        free(dbg -> snaps[k].data);
+    }
+    free(dbg -> snaps);
+    dbg -> snaps = NULL;
+    dbg -> numSnaps = 0;
+    dbg -> capSnaps = 0;
+    if(dbg -> eng != NULL && dbg -> eng -> tickArg == dbg) {
+        engine_tick(dbg -> eng, NULL, NULL, 1);
+    }
+}
+
+/*
+Give the engine the user's breaks and watches again, and nothing else.
+*/
+static void debug_arm (debug_t *dbg)
+{
+    engine_free(dbg -> eng);
+    for(uint32_t i = 0; i < dbg -> numBrks; i++) {
+        engine_break(dbg -> eng, dbg -> brks[i], true);
+    }
+    for(uint32_t i = 0; i < dbg -> numWatches; i++) {
+        engine_watch(dbg -> eng, dbg -> watches[i], dbg -> watchLens[i], true);
+    }
+}
+
+bool debug_break (debug_t *dbg, address_t addr)
+{
+    if(dbg == NULL || addr >= MEMSIZE || dbg -> numBrks == DEBUG_POINTS) {
+        return false;
+    }
+    dbg -> brks[dbg -> numBrks++] = addr;
+    engine_break(dbg -> eng, addr, true);
+    return true;
+}
+
+bool debug_watch (debug_t *dbg, address_t addr, address_t len)
+{
+    if(dbg == NULL || addr >= MEMSIZE || len == 0 || dbg -> numWatches == DEBUG_POINTS) {
+        return false;
+    }
+    dbg -> watches[dbg -> numWatches] = addr;
+    dbg -> watchLens[dbg -> numWatches] = len;
+    dbg -> numWatches++;
+    engine_watch(dbg -> eng, addr, len, true);
+    return true;
+}
+
+bool debug_report (engine_t *eng)
+{
+    if(eng -> limited == ENG_BREAK) {
+        printf("Breakpoint at 0x%04" PRIx64 "\n", eng -> cpu -> pc);
+    } else if(eng -> limited == ENG_WATCH) {
+        printf("Watchpoint: store into 0x%04" PRIx64 "\n", eng -> watchAddr);
+    } else {
+        return false;
+    }
+
+    //fetch from a copy so that a bad instruction leaves the CPU as is
+    y86_t peek = *(eng -> cpu);
+    y86_inst_t inst = fetch(&peek, eng -> memory);
+    if(peek.stat == ADR || peek.stat == INS) {
+        printf("Invalid instruction at 0x%04" PRIx64 "\n", peek.pc);
+    } else {
+        printf("Stopped at: ");
+        disassemble(&inst);
+        printf("\n");
+    }
+    return true;
+}
+
+bool debug_goto (debug_t *dbg, uint64_t count)
+{
+    engine_t *eng = dbg -> eng;
+    bool armed = dbg -> numBrks > 0 || dbg -> numWatches > 0;
+
+    //the user's breaks and watches only stop continuing
+    if(armed) {
+        engine_free(eng);
+    }
+    if(count < eng -> count) {
+        debug_restore(dbg, debug_find(dbg, count));
+    }
+    if(count > eng -> count) {
+        debug_forward(dbg, count);
+    }
+    if(armed) {
+        debug_arm(dbg);
+    }
+    return eng -> count == count;
+}
+
+bool debug_last_write (debug_t *dbg, address_t addr, uint64_t *at)
+{
+    engine_t *eng = dbg -> eng;
+    uint64_t now = eng -> count;
+    if(now == 0 || addr >= MEMSIZE) {
+        return false;
+    }
+
+    //the stores of instructions 1 to now, newest interval first
+    bool found = false;
+    uint64_t hit = 0;
+    engine_free(eng);
+    engine_watch(eng, addr, 1, true);
+    for(uint32_t k = debug_find(dbg, now - 1); ; k--) {
+        uint64_t end = now;
+        if(k + 1 < dbg -> numSnaps && dbg -> snaps[k + 1].count < end) {
+            end = dbg -> snaps[k + 1].count;
+        }
+        debug_restore(dbg, k);
+        while(eng -> count < end) {
+            debug_forward(dbg, end);
+            if(eng -> limited != ENG_WATCH) {
+                break;
+            }
+            found = true;
+            hit = eng -> count;
+        }
+        if(found || k == 0) {
+            break;
+        }
+    }
+    debug_arm(dbg);
+
+    //stop right before the storing instruction
+    debug_goto(dbg, found ? hit - 1 : now);
+    *at = found ? hit - 1 : 0;
+    return found;
+}
+
+bool debug_last_pc (debug_t *dbg, address_t pc, uint64_t *at)
+{
+    engine_t *eng = dbg -> eng;
+    uint64_t now = eng -> count;
+    if(now == 0 || pc >= MEMSIZE) {
+        return false;
+    }
+
+    //counts 0 to now - 1, newest interval first; a run never breaks on its
+    //first instruction, so the start of every interval is looked at here
+    bool found = false;
+    uint64_t hit = 0;
+    engine_free(eng);
+    engine_break(eng, pc, true);
+    for(uint32_t k = debug_find(dbg, now - 1); ; k--) {
+        uint64_t end = now;
+        if(k + 1 < dbg -> numSnaps && dbg -> snaps[k + 1].count < end) {
+            end = dbg -> snaps[k + 1].count;
+        }
+        debug_restore(dbg, k);
+        if(eng -> cpu -> pc == pc && eng -> count < end) {
+            found = true;
+            hit = eng -> count;
+        }
+        while(eng -> count < end) {
+            debug_forward(dbg, end);
+            if(eng -> limited != ENG_BREAK || eng -> count >= end) {
+                break;
+            }
+            found = true;
+            hit = eng -> count;
+        }
+        if(found || k == 0) {
+            break;
+        }
+    }
+    debug_arm(dbg);
+
+    debug_goto(dbg, found ? hit : now);
+    *at = hit;
+    return found;
+}
+
+/*
+Print where the run stands.
+*/
+static void debug_where (debug_t *dbg)
+{
+    y86_t *cpu = dbg -> eng -> cpu;
+    printf("Instruction %" PRIu64 ", PC 0x%04" PRIx64, dbg -> eng -> count, cpu -> pc);
+    if(cpu -> stat != AOK) {
+        printf(" (stopped)");
+    }
+    printf("\n");
+}
+
+/*
+Run instructions one at a time, traced the way -E traces them.
+*/
+static void debug_step (debug_t *dbg, uint64_t n)
+{
+    engine_t *eng = dbg -> eng;
+    for(uint64_t i = 0; i < n && eng -> cpu -> stat == AOK; i++) {
+        //fetch from a copy so that a bad instruction leaves the CPU as is
+        y86_t peek = *(eng -> cpu);
+        y86_inst_t inst = fetch(&peek, eng -> memory);
+        if(peek.stat == ADR || peek.stat == INS) {
+            printf("Invalid instruction at 0x%04" PRIx64 "\n", peek.pc);
+        } else {
+            printf("Executing: ");
+            disassemble(&inst);
+            printf("\n");
+        }
+
+        //a step goes past a break at the PC
+        io_current -> quietUntil = dbg -> highWater;
+        engine_limits(eng, 0, 0);
+        eng -> brkPass = eng -> count;
+        engine_step(eng, false);
+        if(eng -> count > dbg -> highWater) {
+            dbg -> highWater = eng -> count;
+        }
+        dump_cpu_state(eng -> cpu);
+        printf("\n");
+    }
+}
+
+/*
+Help text of the command loop.
+*/
+static void debug_help (void)
+{
+    printf("Commands:\n");
+    printf("  s [n]          Step n instructions (1), traced\n");
+    printf("  c [n]          Continue n instructions (to the end)\n");
+    printf("  rs [n]         Step back n instructions (1)\n");
+    printf("  rw <addr>      Go back to the last instruction storing into addr\n");
+    printf("  rp <addr>      Go back to the last time the PC was addr\n");
+    printf("  g <n>          Go to instruction n, forward or back\n");
+    printf("  b <addr>       Stop continuing before the instruction at addr\n");
+    printf("  w <addr> [n]   Stop continuing after a store into n bytes at addr (8)\n");
+    printf("  d              Delete every break and watch\n");
+    printf("  i              Show the CPU state\n");
+    printf("  x <addr> [n]   Show n bytes of memory at addr (64)\n");
+    printf("  h              Show this help\n");
+    printf("  q              Quit the debugger\n");
+}
+
+void debug_shell (debug_t *dbg)
+{
+    engine_t *eng = dbg -> eng;
+    char line[256];
+    char cmd[16];
+    char arg1[64];
+    char arg2[64];
+
+    printf("Debugging; h for help\n");
+    debug_where(dbg);
+    while(true) {
+        printf("(y86) ");
+        fflush(stdout);
+        if(fgets(line, sizeof(line), stdin) == NULL) {
+            printf("\n");
+            break;
+        }
+        arg1[0] = '\0';
+        arg2[0] = '\0';
+        int n = sscanf(line, "%15s %63s %63s", cmd, arg1, arg2);
+        if(n < 1) {
+            continue;
+        }
+
+        char *end = NULL;
+        uint64_t a = strtoull(arg1, &end, 0);
+        bool has1 = n >= 2 && *end == '\0';
+        uint64_t b = strtoull(arg2, &end, 0);
+        bool has2 = n >= 3 && *end == '\0';
+
+        if(strcmp(cmd, "s") == 0 || strcmp(cmd, "step") == 0) {
+            debug_step(dbg, has1 ? a : 1);
+            debug_where(dbg);
+        } else if(strcmp(cmd, "c") == 0 || strcmp(cmd, "continue") == 0) {
+            debug_forward(dbg, has1 ? eng -> count + a : 0);
+            if(debug_report(eng)) {
+                dump_cpu_state(eng -> cpu);
+            }
+            debug_where(dbg);
+        } else if((strcmp(cmd, "b") == 0 || strcmp(cmd, "break") == 0) && has1) {
+            if(!debug_break(dbg, (address_t)a)) {
+                printf("Cannot break at 0x%04" PRIx64 "\n", a);
+            }
+        } else if((strcmp(cmd, "w") == 0 || strcmp(cmd, "watch") == 0) && has1) {
+            if(!debug_watch(dbg, (address_t)a, has2 ? (address_t)b : 8)) {
+                printf("Cannot watch 0x%04" PRIx64 "\n", a);
+            }
+        } else if(strcmp(cmd, "d") == 0 || strcmp(cmd, "delete") == 0) {
+            dbg -> numBrks = 0;
+            dbg -> numWatches = 0;
+            debug_arm(dbg);
+        } else if(strcmp(cmd, "rs") == 0 || strcmp(cmd, "rstep") == 0) {
+            uint64_t back = has1 ? a : 1;
+            debug_goto(dbg, back < eng -> count ? eng -> count - back : 0);
+            debug_where(dbg);
+        } else if((strcmp(cmd, "rw") == 0 || strcmp(cmd, "rwrite") == 0) && has1) {
+            uint64_t at = 0;
+            if(!debug_last_write(dbg, (address_t)a, &at)) {
+                printf("No earlier store into 0x%04" PRIx64 "\n", a);
+            } else {
+                printf("Stored into 0x%04" PRIx64 " by the instruction at 0x%04" PRIx64 "\n", a,
+                       eng -> cpu -> pc);
+            }
+            debug_where(dbg);
+        } else if((strcmp(cmd, "rp") == 0 || strcmp(cmd, "rpc") == 0) && has1) {
+            uint64_t at = 0;
+            if(!debug_last_pc(dbg, (address_t)a, &at)) {
+                printf("The PC was never 0x%04" PRIx64 " before\n", a);
+            }
+            debug_where(dbg);
+        } else if((strcmp(cmd, "g") == 0 || strcmp(cmd, "goto") == 0) && has1) {
+            if(!debug_goto(dbg, a)) {
+                printf("The program ended before instruction %" PRIu64 "\n", a);
+            }
+            debug_where(dbg);
+        } else if(strcmp(cmd, "i") == 0 || strcmp(cmd, "info") == 0) {
+            dump_cpu_state(eng -> cpu);
+            printf("Total execution count: %" PRIu64 "\n", eng -> count);
+        } else if((strcmp(cmd, "x") == 0 || strcmp(cmd, "examine") == 0) && has1 && a < MEMSIZE) {
+            uint64_t len = has2 ? b : 64;
+            uint64_t last = a + len < MEMSIZE ? a + len : MEMSIZE;
+            dump_memory(eng -> memory, (uint16_t)a, (uint16_t)last);
+        } else if(strcmp(cmd, "q") == 0 || strcmp(cmd, "quit") == 0) {
+            break;
+        } else {
+            debug_help();
+        }
+        if(dbg -> failed) {
+            printf("Out of memory for snapshots; going back may be slow\n");
+            dbg -> failed = false;
+        }
+    }
+}
@@ -0,0 +1,159 @@
+#ifndef __CS261_DEBUG__
+#define __CS261_DEBUG__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+#include "engine.h"
+#include "mem.h"
+#include "io.h"
+
+/* instructions between two snapshots */
+#define DEBUG_SNAPSHOT 100000
+
+/* breaks and watches the debugger keeps */
+#define DEBUG_POINTS 64
+
+/* state of a run at one instruction count
+
+   Only the pages written since the previous snapshot are kept (all of them
+   in the first one), so the memory at a snapshot is found by going back
+   through the snapshots until every page has been seen once. */
+typedef struct debug_snap {
+    uint64_t count;             // retired instructions
+    y86_t cpu;                  // CPU state
+    io_mark_t io;               // position in the I/O
+    uint32_t numPages;          // number of pages kept
+    uint8_t *pages;             // their page numbers
+    byte_t *data;               // their contents, numPages * PAGESIZE bytes
+} debug_snap_t;
+
+/* reverse-capable debugger
+
+   Forward execution takes a snapshot every so many instructions on the
+   engine tick. Going back restores the nearest snapshot at or before the
+   target and runs forward from it at full speed; the input traps replay
+   their reads from a log and output already printed once is not printed
+   again, so history runs the same way every time. */
+typedef struct debug {
+
+    engine_t *eng;              // engine being debugged
+    y86_mem_t *mem;             // page table tracking dirty pages
+    uint64_t every;             // instructions between two snapshots
+
+    debug_snap_t *snaps;        // snapshots in count order
+    uint32_t numSnaps;          // number of snapshots
+    uint32_t capSnaps;          // allocated snapshots
+
+    uint64_t highWater;         // furthest count reached
+    bool failed;                // a snapshot could not be allocated
+
+    address_t brks[DEBUG_POINTS];       // breaks set by the user
+    uint32_t numBrks;
+    address_t watches[DEBUG_POINTS];    // watches set by the user: first byte
+    address_t watchLens[DEBUG_POINTS];  //   and number of bytes
+    uint32_t numWatches;
+
+} debug_t;
+
+/**
+ * @brief Start taking snapshots of an engine
+ *
+ * Takes the first snapshot right away (every page is brought in first)
+ * and then one every so many instructions through the engine tick.
+ *
+ * @param dbg Pointer to the debugger
+ * @param eng Engine to debug, with the page table of mem_current
+ * @param every Instructions between two snapshots
+ * @returns True if the first snapshot could be taken, false otherwise
+ */
+bool debug_init (debug_t *dbg, engine_t *eng, uint64_t every);
+
+/**
+ * @brief Release the snapshots and remove the engine tick
+ *
+ * @param dbg Pointer to the debugger
+ */
+void debug_free (debug_t *dbg);
+
+/**
+ * @brief Bring the run to an instruction count, forward or back
+ *
+ * @param dbg Pointer to the debugger
+ * @param count Instruction count to stop at
+ * @returns True if the run stopped at the count, false if it ended before
+ */
+bool debug_goto (debug_t *dbg, uint64_t count);
+
+/**
+ * @brief Go back to the last instruction that stored into an address
+ *
+ * The run stops right before that instruction, so its PC is the storing
+ * instruction's; going back again finds the store before it. The run does
+ * not move when there is none.
+ *
+ * @param dbg Pointer to the debugger
+ * @param addr Address written
+ * @param at Set to the count right before that instruction
+ * @returns True if there is one, false otherwise
+ */
+bool debug_last_write (debug_t *dbg, address_t addr, uint64_t *at);
+
+/**
+ * @brief Go back to the last count before the current one at which the PC
+ * was at an address
+ *
+ * The run does not move when there is none.
+ *
+ * @param dbg Pointer to the debugger
+ * @param pc Address of the instruction
+ * @param at Set to that count
+ * @returns True if there is one, false otherwise
+ */
+bool debug_last_pc (debug_t *dbg, address_t pc, uint64_t *at);
+
+/**
+ * @brief Stop forward runs before the instruction at an address
+ *
+ * @param dbg Pointer to the debugger
+ * @param addr Address of the instruction
+ * @returns True if the break was set, false if there are too many
+ */
+bool debug_break (debug_t *dbg, address_t addr);
+
+/**
+ * @brief Stop forward runs after a store into a range of addresses
+ *
+ * @param dbg Pointer to the debugger
+ * @param addr First address watched
+ * @param len Number of bytes watched
+ * @returns True if the watch was set, false if there are too many
+ */
+bool debug_watch (debug_t *dbg, address_t addr, address_t len);
+
+/**
+ * @brief Print why an engine stopped at a break or watch, if it did
+ *
+ * Names the break or the byte written and disassembles the instruction
+ * the run stopped before; the CPU state is left to the caller.
+ *
+ * @param eng Engine that stopped
+ * @returns True if the engine stopped at a break or watch
+ */
+bool debug_report (engine_t *eng);
+
+/**
+ * @brief Run the debugger's command loop on standard input
+ *
+ * Commands share standard input with the program's input traps; reads
+ * made once are replayed whenever history runs again.
+ *
+ * @param dbg Pointer to the debugger
+ */
+void debug_shell (debug_t *dbg);
+
+#endif
@@ -0,0 +1,589 @@
+/*
+ * Lockstep differential testing of the execution engines
+ *
+ * Name: Griffin Moran
+ */
+
+#include "difftest.h"
+#include "p3-disas.h"
+#include "p4-interp.h"
+#include "ir.h"
+#include "io.h"
+
+/* instructions a random program may retire before it is cut off */
+#define DIFFTEST_LIMIT 100000
+
+bool difftest_init (difftest_t *dt, engine_t *eng)
+{
+    if(dt == NULL || eng == NULL || eng -> cpu == NULL || eng -> memory == NULL) {
+        return false;
+    }
+    memset(dt, 0, sizeof(difftest_t));
+    dt -> refMemory = (byte_t*)malloc(MEMSIZE);
+    if(dt -> refMemory == NULL) {
+        return false;
+    }
+
+    //the reference starts from a fully loaded copy of the engine's state
+    mem_fault_all(mem_current);
+    memcpy(dt -> refMemory, eng -> memory, MEMSIZE);
+    dt -> ref = *(eng -> cpu);
+    dt -> refCount = eng -> count;
+    dt -> pages = mem_current;
+
+    //same permissions, but no cached code to report stores into
+    mem_init(&(dt -> refPages), dt -> refMemory);
+    if(dt -> pages != NULL) {
+        for(int p = 0; p < NUMPAGES; p++) {
+            dt -> refPages.page[p] = dt -> pages -> page[p] & ~(PG_CODE | PG_WATCH);
+        }
+        dt -> refPages.enforce = dt -> pages -> enforce;
+    }
+    return true;
+}
+
+void difftest_free (difftest_t *dt)
+{
+    if(dt == NULL) {
+        return;
+    }
+    free(dt -> refMemory);
+    memset(dt, 0, sizeof(difftest_t));
+}
+
+/*
+One iteration of the trace loop on the reference copy; false if the
+instruction could not be fetched.
+*/
+static bool difftest_ref_step (difftest_t *dt)
+{
+    y86_t *cpu = &(dt -> ref);
+    bool cond = false;
+    y86_reg_t valA = 0;
+
+    y86_inst_t inst = fetch(cpu, dt -> refMemory);
+    if(cpu -> stat == ADR || cpu -> stat == INS) {
+        return false;
+    }
+    dt -> trail[dt -> trailLen % DIFFTEST_TRAIL] = inst;
+    dt -> trailPc[dt -> trailLen % DIFFTEST_TRAIL] = cpu -> pc;
+    dt -> trailLen++;
+
+    y86_reg_t valE = decode_execute(cpu, &inst, &cond, &valA);
+    memory_wb_pc(cpu, &inst, dt -> refMemory, cond, valA, valE);
+    dt -> refCount++;
+    return true;
+}
+
+/*
+Whether the optimized block at an address would run an I/O trap.
+*/
+static bool difftest_io_block (engine_t *eng, address_t pc)
+{
+    ir_program_t *ir = eng -> ir;
+    if(ir == NULL || ir -> block == NULL || pc >= MEMSIZE || ir -> block[pc] < 0) {
+        return false;
+    }
+
+    ir_block_t *blk = &(ir -> blocks[ir -> block[pc]]);
+    for(uint32_t k = 0; k < blk -> count; k++) {
+        ir_op_t *op = &(ir -> ops[blk -> first + k]);
+        if(op -> kind == IR_EXEC && (op -> op >> 4) == IOTRAP) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+Whether the I/O is where the engine's run of a trap left it.
+*/
+static bool difftest_same_io (y86_io_t *io, io_mark_t *after)
+{
+    io_mark_t now;
+    io_mark(io, &now);
+    return !io -> mismatch && now.pos == after -> pos && now.records == after -> records &&
+           now.inputPos == after -> inputPos && now.bufLen == after -> bufLen &&
+           memcmp(now.output, after -> output, sizeof(now.output)) == 0;
+}
+
+/*
+Compare everything the two runs can observe; the address space is compared
+with memcmp, which the C library vectorizes.
+*/
+static bool difftest_same (difftest_t *dt, engine_t *eng)
+{
+    y86_t *ref = &(dt -> ref);
+    y86_t *cpu = eng -> cpu;
+
+    return ref -> pc == cpu -> pc && ref -> stat == cpu -> stat &&
+           ref -> zf == cpu -> zf && ref -> sf == cpu -> sf && ref -> of == cpu -> of &&
+           dt -> refCount == eng -> count &&
+           memcmp(ref -> reg, cpu -> reg, sizeof(ref -> reg)) == 0 &&
+           memcmp(dt -> refMemory, eng -> memory, MEMSIZE) == 0;
+}
+
+/*
+Print the instructions of the step that diverged and both states.
+*/
+static void difftest_report (difftest_t *dt, engine_t *eng, address_t start)
+{
+    printf("Divergence in the step starting at 0x%04" PRIx64 " (step %" PRIu64 ")\n",
+           start, dt -> steps);
+    if(dt -> trailLen > DIFFTEST_TRAIL) {
+        printf("  ... %" PRIu32 " earlier instructions\n", dt -> trailLen - DIFFTEST_TRAIL);
+    }
+    uint32_t first = dt -> trailLen > DIFFTEST_TRAIL ? dt -> trailLen - DIFFTEST_TRAIL : 0;
+    for(uint32_t i = first; i < dt -> trailLen; i++) {
+        printf("  0x%04" PRIx64 ": ", dt -> trailPc[i % DIFFTEST_TRAIL]);
+        disassemble(&(dt -> trail[i % DIFFTEST_TRAIL]));
+        printf("\n");
+    }
+
+    printf("Reference (%" PRIu64 " instructions):\n", dt -> refCount);
+    dump_cpu_state(&(dt -> ref));
+    printf("Engine (%" PRIu64 " instructions):\n", eng -> count);
+    dump_cpu_state(eng -> cpu);
+
+    for(address_t a = 0; a < MEMSIZE; a++) {
+        if(dt -> refMemory[a] != eng -> memory[a]) {
+            printf("Memory differs at 0x%04" PRIx64 ": %02x (reference) vs %02x (engine)\n",
+                   a, dt -> refMemory[a], eng -> memory[a]);
+            break;
+        }
+    }
+}
+
+bool difftest_run (difftest_t *dt, engine_t *eng, uint64_t limit)
+{
+    if(dt == NULL || eng == NULL || dt -> refMemory == NULL) {
+        return true;
+    }
+
+    y86_t *cpu = eng -> cpu;
+    y86_io_t *io = io_current;
+    io_mark_t mark;
+    io_mark_t after;
+
+    //a break at the first instruction does not stop the run (see engine_run)
+    eng -> brkPass = eng -> count;
+    while(cpu -> stat == AOK && eng -> limited == ENG_RUNNING && (limit == 0 || eng -> count < limit)) {
+        address_t pc = cpu -> pc;
+        uint64_t before = eng -> count;
+        dt -> steps++;
+        dt -> trailLen = 0;
+
+        //blocks containing an I/O trap are run an instruction at a time
+        bool trap = pc < MEMSIZE && (eng -> memory[pc] >> 4) == IOTRAP;
+        if(trap) {
+            io_mark(io, &mark);
+        }
+        engine_step(eng, !trap && !difftest_io_block(eng, pc));
+
+        const uint64_t *clock = io -> clock;
+        uint64_t quiet = io -> quietUntil;
+        uint64_t deadline = io -> deadline;
+        if(trap) {
+            //a trap still waiting for input did not run
+            if(eng -> count == before && cpu -> stat == AOK) {
+                continue;
+            }
+
+            //input that cannot be read twice: the reference takes over the
+            //trap's effects
+            if(!io -> buffered && !io -> replay) {
+                dt -> ref = *cpu;
+                dt -> refCount = eng -> count;
+                memcpy(dt -> refMemory, eng -> memory, MEMSIZE);
+                dt -> mirrored++;
+                continue;
+            }
+
+            //otherwise the reference runs the trap from the same point of
+            //the I/O: input comes back from the buffer or the replay tape,
+            //stamped with the reference's count, and its output is dropped
+            io_mark(io, &after);
+            io_rewind(io, &mark);
+            io -> clock = &(dt -> refCount);
+            io -> quietUntil = eng -> count;
+            io -> deadline = 0;
+        }
+
+        //the reference retires as many instructions with its own page table
+        mem_current = &(dt -> refPages);
+        while(dt -> refCount < eng -> count && dt -> ref.stat == AOK) {
+            if(!difftest_ref_step(dt)) {
+                break;
+            }
+        }
+
+        //an engine that stopped without retiring must have failed to fetch
+        if(cpu -> stat != AOK && dt -> ref.stat == AOK && dt -> refCount == eng -> count) {
+            fetch(&(dt -> ref), dt -> refMemory);
+        }
+        mem_current = dt -> pages;
+
+        bool sameIo = !trap || difftest_same_io(io, &after);
+        uint64_t refRecords = io -> records;
+        if(trap) {
+            io_rewind(io, &after);
+            io -> clock = clock;
+            io -> quietUntil = quiet;
+            io -> deadline = deadline;
+        }
+        if(!difftest_same(dt, eng) || !sameIo) {
+            difftest_report(dt, eng, pc);
+            if(!sameIo) {
+                printf("I/O differs: the reference took %" PRIu64 " input records, the engine %"
+                       PRIu64 "\n", refRecords, after.records);
+            }
+            return false;
+        }
+    }
+    engine_finish(eng);
+    return true;
+}
+
+/* state of the random program generator */
+typedef struct difftest_gen {
+    byte_t *memory;             // address space being written
+    address_t pc;               // next code address
+    uint64_t state;             // xorshift state
+} difftest_gen_t;
+
+/* registers the generator may clobber (%rsp, %rbx and %rbp are kept) */
+static const uint8_t genRegs[] = {
+    RAX, RCX, RDX, RSI, RDI, R8, R9, R10, R11, R12, R13, R14
+};
+
+/* layout of every random program */
+#define GEN_FN     0x100        // called function, at the start of the code
+#define GEN_CODE   0x380        // the body ends before this address
+#define GEN_DATA   0x400        // data block, addressed through %rbx/%rbp
+#define GEN_STACK  0xe00        // stack segment, %rsp starts at its end
+
+/*
+xorshift64* step.
+*/
+static inline uint64_t gen_rand (difftest_gen_t *g)
+{
+    g -> state ^= g -> state >> 12;
+    g -> state ^= g -> state << 25;
+    g -> state ^= g -> state >> 27;
+    return g -> state * 2685821657736338717ULL;
+}
+
+static inline uint64_t gen_below (difftest_gen_t *g, uint64_t n)
+{
+    return gen_rand(g) % n;
+}
+
+static inline uint8_t gen_reg (difftest_gen_t *g)
+{
+    return genRegs[gen_below(g, sizeof(genRegs))];
+}
+
+/*
+Constant biased towards the edge cases of the condition codes.
+*/
+static int64_t gen_value (difftest_gen_t *g)
+{
+    switch(gen_below(g, 7)) {
+        case (0):
+            return 0;
+
+        case (1):
+            return 1;
+
+        case (2):
+            return -1;
+
+        case (3):
+            return INT64_MAX;
+
+        case (4):
+            return INT64_MIN;
+
+        default:
+            return (int64_t)gen_below(g, 200) - 100;
+    }
+}
+
+static void gen_byte (difftest_gen_t *g, byte_t b)
+{
+    g -> memory[g -> pc++] = b;
+}
+
+static void gen_quad (difftest_gen_t *g, uint64_t v)
+{
+    memcpy(g -> memory + g -> pc, &v, sizeof(uint64_t));
+    g -> pc += 8;
+}
+
+static void gen_rr (difftest_gen_t *g, byte_t op, uint8_t ra, uint8_t rb)
+{
+    gen_byte(g, op);
+    gen_byte(g, (ra << 4) | rb);
+}
+
+static void gen_irmovq (difftest_gen_t *g, uint8_t rb, int64_t v)
+{
+    gen_rr(g, IRMOVQ << 4, NOREG, rb);
+    gen_quad(g, v);
+}
+
+static void gen_mem (difftest_gen_t *g, byte_t icode, uint8_t ra, uint8_t rb, int64_t d)
+{
+    gen_rr(g, icode << 4, ra, rb);
+    gen_quad(g, d);
+}
+
+static void gen_jump (difftest_gen_t *g, byte_t op, address_t dest)
+{
+    gen_byte(g, op);
+    gen_quad(g, dest);
+}
+
+/*
+Write one random program into a zeroed address space; returns the number of
+program headers and sets the entry point.
+*/
+static uint16_t gen_program (uint64_t seed, byte_t *memory, elf_phdr_t *phdrs, address_t *entry)
+{
+    difftest_gen_t g;
+    g.memory = memory;
+    g.pc = GEN_FN;
+    g.state = (seed ^ 0x9e3779b97f4a7c15ULL) | 1;
+
+    //fn: a leaf function that uses the stack
+    gen_rr(&g, OPQ << 4 | ADD, RAX, RCX);
+    gen_rr(&g, PUSHQ << 4, RCX, NOREG);
+    gen_rr(&g, POPQ << 4, RDX, NOREG);
+    gen_byte(&g, RET << 4);
+
+    *entry = g.pc;
+    gen_irmovq(&g, RSP, GEN_STACK + 0x100);
+    gen_irmovq(&g, RBX, GEN_DATA);
+    gen_irmovq(&g, RBP, GEN_DATA + 0x20);
+    for(size_t i = 0; i < sizeof(genRegs); i++) {
+        gen_irmovq(&g, genRegs[i], gen_value(&g));
+    }
+
+    int depth = 0;
+    int n = 5 + gen_below(&g, 55);
+    static const int64_t disp[] = { 0, 8, 16, 4 };
+    for(int i = 0; i < n && g.pc < GEN_CODE; i++) {
+        uint8_t a = gen_reg(&g);
+        uint8_t b = gen_reg(&g);
+        uint8_t base = gen_below(&g, 2) ? RBX : RBP;
+
+        switch(gen_below(&g, 16)) {
+            case (0):
+                gen_irmovq(&g, a, gen_below(&g, 10) - 5);
+                break;
+
+            case (1):
+                gen_rr(&g, CMOV << 4 | gen_below(&g, BADCMOV), a, b);
+                break;
+
+            case (2):
+            case (3):
+                gen_rr(&g, OPQ << 4 | gen_below(&g, BADOP), a, gen_below(&g, 10) < 3 ? a : b);
+                break;
+
+            case (4):
+                gen_mem(&g, RMMOVQ, a, base, disp[gen_below(&g, 4)]);
+                break;
+
+            case (5):
+                gen_mem(&g, MRMOVQ, a, base, disp[gen_below(&g, 4)]);
+                break;
+
+            case (6):
+            case (7):
+                if(depth < 20) {
+                    gen_rr(&g, PUSHQ << 4, a, NOREG);
+                    depth++;
+                    break;
+                }
+                //fall through to a pop
+            case (8):
+                if(depth > 0) {
+                    gen_rr(&g, POPQ << 4, a, NOREG);
+                    depth--;
+                }
+                break;
+
+            case (9):
+                //forward branch over one instruction
+                gen_jump(&g, JUMP << 4 | (1 + gen_below(&g, BADJUMP - 1)), g.pc + 19);
+                gen_irmovq(&g, a, 3);
+                break;
+
+            case (10):
+                gen_jump(&g, CALL << 4, GEN_FN);
+                break;
+
+            case (11):
+                gen_rr(&g, PUSHQ << 4, RSP, NOREG);
+                gen_rr(&g, POPQ << 4, a, NOREG);
+                break;
+
+            case (12):
+                if(depth > 0) {
+                    gen_mem(&g, MRMOVQ, a, RSP, 0);
+                } else {
+                    gen_byte(&g, NOP << 4);
+                }
+                break;
+
+            case (13): {
+                //store into the code about to run: a halt, nops running
+                //into one, or arbitrary bytes
+                static const uint64_t patch[] = { 0, 0x0010101010101010ULL };
+                address_t target = g.pc + 20 + gen_below(&g, 4);
+                if(gen_below(&g, 4) != 0) {
+                    gen_rr(&g, OPQ << 4 | gen_below(&g, BADOP), a, b);
+                    break;
+                }
+                gen_irmovq(&g, a, gen_below(&g, 3) ? patch[gen_below(&g, 2)] : gen_rand(&g));
+                if(gen_below(&g, 2)) {
+                    gen_mem(&g, RMMOVQ, a, RBX, (int64_t)target - GEN_DATA);
+                } else {
+                    gen_mem(&g, RMMOVQ, a, NOREG, target);
+                }
+                break;
+            }
+
+            case (14):
+                //rarely, an access near or past the end of the address space
+                if(gen_below(&g, 4) == 0) {
+                    gen_mem(&g, MRMOVQ, a, RBX, MEMSIZE - GEN_DATA - 16 + gen_below(&g, 16));
+                } else {
+                    gen_rr(&g, CMOV << 4 | RRMOVQ, a, b);
+                }
+                break;
+
+            default:
+                gen_byte(&g, NOP << 4);
+                break;
+        }
+    }
+
+    //bounded loop through memory and the stack
+    address_t loop;
+    gen_irmovq(&g, R14, 1 + gen_below(&g, 64));
+    gen_irmovq(&g, R13, 1);
+    loop = g.pc;
+    gen_rr(&g, OPQ << 4 | ADD, R14, RAX);
+    gen_rr(&g, PUSHQ << 4, RAX, NOREG);
+    gen_rr(&g, POPQ << 4, RCX, NOREG);
+    gen_mem(&g, RMMOVQ, RCX, RBX, 8);
+    gen_mem(&g, MRMOVQ, RDX, RBX, 8);
+    gen_rr(&g, OPQ << 4 | SUB, R13, R14);
+    gen_jump(&g, JUMP << 4 | JNE, loop);
+    gen_byte(&g, HALT << 4);
+
+    for(int i = 0; i < 4; i++) {
+        uint64_t v = 5 + i;
+        memcpy(memory + GEN_DATA + 8 * i, &v, sizeof(uint64_t));
+    }
+
+    memset(phdrs, 0, 3 * sizeof(elf_phdr_t));
+    phdrs[0].p_vaddr = GEN_FN;
+    phdrs[0].p_size = g.pc - GEN_FN;
+    phdrs[0].p_type = CODE;
+    phdrs[0].p_flags = 5;
+    phdrs[1].p_vaddr = GEN_DATA;
+    phdrs[1].p_size = 0x40;
+    phdrs[1].p_type = DATA;
+    phdrs[1].p_flags = 6;
+    phdrs[2].p_vaddr = GEN_STACK;
+    phdrs[2].p_size = 0x100;
+    phdrs[2].p_type = STACK;
+    phdrs[2].p_flags = 6;
+    return 3;
+}
+
+bool difftest_program (byte_t *memory, elf_phdr_t *phdrs, uint16_t numphdrs, address_t entry,
+                       uint64_t limit, y86_t *cpu, uint64_t *count)
+{
+    if(memory == NULL || cpu == NULL) {
+        return true;
+    }
+    y86_mem_t *saved = mem_current;
+    y86_mem_t pages;
+    mem_init(&pages, memory);
+    mem_current = &pages;
+
+    y86_decoded_t prog;
+    ir_program_t ir;
+    memset(&ir, 0, sizeof(ir_program_t));
+    decode_program(memory, phdrs, numphdrs, &prog);
+    ir_build(&prog, entry, &ir);
+    ir_optimize(&ir);
+
+    memset(cpu, 0, sizeof(y86_t));
+    cpu -> stat = AOK;
+    cpu -> pc = entry;
+
+    engine_t eng;
+    engine_init(&eng, cpu, memory, &prog);
+    eng.ir = &ir;
+
+    bool same = true;
+    difftest_t dt;
+    if(difftest_init(&dt, &eng)) {
+        same = difftest_run(&dt, &eng, limit);
+    }
+    if(count != NULL) {
+        *count = eng.count;
+    }
+
+    difftest_free(&dt);
+    ir_free(&ir);
+    free_decoded(&prog);
+    mem_current = saved;
+    return same;
+}
+
+uint64_t difftest_random (uint64_t count, uint64_t seed)
+{
+    uint64_t diverged = 0;
+    uint64_t limited = 0;
+    uint64_t insns = 0;
+    byte_t *memory = (byte_t*)malloc(MEMSIZE);
+    if(memory == NULL) {
+        return 0;
+    }
+
+    //random programs read no input and their output is not kept
+    y86_io_t *saved = io_current;
+    y86_io_t io;
+    io_current = &io;
+
+    for(uint64_t i = 0; i < count; i++) {
+        elf_phdr_t phdrs[3];
+        address_t entry;
+        y86_t cpu;
+        uint64_t retired = 0;
+
+        memset(memory, 0, MEMSIZE);
+        uint16_t numphdrs = gen_program(seed + i, memory, phdrs, &entry);
+        io_init_buffer(&io, NULL, 0);
+
+        if(!difftest_program(memory, phdrs, numphdrs, entry, DIFFTEST_LIMIT, &cpu, &retired)) {
+            printf("Random program %" PRIu64 " diverged\n\n", seed + i);
+            diverged++;
+        } else if(cpu.stat == AOK) {
+            limited++;
+        }
+        insns += retired;
+    }
+
+    io_current = saved;
+    free(memory);
+    printf("Difftest: %" PRIu64 " programs, %" PRIu64 " instructions, %" PRIu64
+           " cut off, %" PRIu64 " diverged\n", count, insns, limited, diverged);
+    return diverged;
+}
@@ -0,0 +1,112 @@
+#ifndef __CS261_DIFFTEST__
+#define __CS261_DIFFTEST__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+#include "engine.h"
+#include "mem.h"
+
+/* instructions of the current step kept for the divergence report */
+#define DIFFTEST_TRAIL 8
+
+/* reference interpreter run in lockstep with an engine */
+typedef struct difftest {
+
+    y86_t ref;                  // reference CPU
+    byte_t *refMemory;          // reference copy of the address space
+    y86_mem_t refPages;         // page table of the reference copy
+    uint64_t refCount;          // instructions retired by the reference
+
+    y86_mem_t *pages;           // page table of the engine
+
+    uint64_t steps;             // comparisons made
+    uint64_t mirrored;          // I/O traps whose input could not be read
+                                // again, copied from the engine
+
+    y86_inst_t trail[DIFFTEST_TRAIL];   // last instructions of the step
+    address_t trailPc[DIFFTEST_TRAIL];  //   and their addresses
+    uint32_t trailLen;          // instructions retired in the step
+
+} difftest_t;
+
+/**
+ * @brief Set up a reference copy of an engine that is ready to run
+ *
+ * Every page of the engine's address space is brought in and copied; the
+ * reference gets its own page table with the same permissions, so it is
+ * never affected by the engine's write barrier or demand paging.
+ *
+ * @param dt Pointer to the harness
+ * @param eng Engine after engine_init, with mem_current as its page table
+ * @returns True if the copy could be allocated, false otherwise
+ */
+bool difftest_init (difftest_t *dt, engine_t *eng);
+
+/**
+ * @brief Run an engine and the reference loop in lockstep
+ *
+ * The engine advances one engine_step at a time (a whole optimized block
+ * where there is one); the fetch/decode_execute/memory_wb_pc loop then
+ * retires the same number of instructions, and registers, flags, PC,
+ * status, counts and the whole address space are compared. I/O traps run
+ * on the engine and then on the reference from the same point of the I/O,
+ * which also has to end up in the same place: buffered input is read
+ * again, input from stdin comes back from a replay log or tape (see
+ * io_tape), and the reference's output is dropped. Only a trap whose input
+ * cannot be read again (stdin with no log to replay) has its effects
+ * copied to the reference instead. At the first divergence the
+ * instructions of the step and both states are printed.
+ *
+ * @param dt Pointer to the harness
+ * @param eng Engine set up by difftest_init
+ * @param limit Stop once this many instructions retired (0 for no limit)
+ * @returns False if the engine diverged from the reference, true otherwise
+ */
+bool difftest_run (difftest_t *dt, engine_t *eng, uint64_t limit);
+
+/**
+ * @brief Release the reference copy
+ *
+ * @param dt Pointer to the harness
+ */
+void difftest_free (difftest_t *dt);
+
+/**
+ * @brief Decode, optimize and difftest a program loaded into memory
+ *
+ * The program runs from a fresh CPU at its entry point with its own page
+ * table; mem_current is restored afterwards.
+ *
+ * @param memory Pointer to the loaded Y86 address space
+ * @param phdrs Program headers of the program
+ * @param numphdrs Number of program headers
+ * @param entry Entry point of the program
+ * @param limit Stop once this many instructions retired (0 for no limit)
+ * @param cpu Pointer to the CPU, left in its final state
+ * @param count Pointer to the number of retired instructions, or NULL
+ * @returns False if the engine diverged from the reference, true otherwise
+ */
+bool difftest_program (byte_t *memory, elf_phdr_t *phdrs, uint16_t numphdrs, address_t entry,
+                       uint64_t limit, y86_t *cpu, uint64_t *count);
+
+/**
+ * @brief Generate random valid programs and difftest every one of them
+ *
+ * Programs are built straight into memory from a seeded generator: ALU
+ * operations on edge-case values, conditional moves, loads and stores
+ * around a data block, pushes and pops, forward branches, calls, bounded
+ * loops and the occasional store into the code itself. Each is decoded,
+ * optimized and run under difftest_run with a fixed instruction limit.
+ *
+ * @param count Number of programs
+ * @param seed Seed of the first program; program i uses seed + i
+ * @returns Number of programs that diverged
+ */
+uint64_t difftest_random (uint64_t count, uint64_t seed);
+
+#endif
@@ -95,4 +95,55 @@ typedef struct __attribute__((__packed__)) elf_phdr {
     uint32_t magic;         /* DEADBEEF */
 } elf_phdr_t;
 
+/*
+   Mini-ELF version 2 (selected by e_version = 2; the version field stays in
+   the first two bytes so a reader can dispatch before parsing anything else)
+
+   All fields are naturally aligned and the program header table must start
+   at an 8-byte aligned offset, so a mapped file can be used in place as an
+   array of elf_phdr2_t without per-field parsing. Offsets and addresses are
+   64 bits wide, which lifts the 64 KiB limit of the 16-bit version 1 header.
+
+   ELF header structure (48 bytes):
+   +----------------------------------------------------------------------------+
+   |  0   1  |  2   3  |  4 .. 7  |  8 .. 15  | 16 .. 23  | 24 .. 31  | 32 .. 39 |
+   | version | hdrsize | numphdr  | entry     | phdr      | symtab    | strtab   |
+   +----------------------------------------------------------------------------+
+   | 40 .. 43  | 44 .. 47       |
+   | phentsize | magic number   |
+   +----------------------------+
+
+   hdrsize = 48 and phentsize = 32 (the sizes of the structures below); the
+   magic number is "ELF\0" as in version 1.
+
+   ELF program header structure (32 bytes):
+   +-----------------------------------------------------------------------+
+   |  0 .. 7  |  8 .. 15 | 16 .. 23  | 24 25 | 26 27 | 28 29 30 31         |
+   | offset   | size     | virt addr | type  | flags | magic number        |
+   +-----------------------------------------------------------------------+
+
+   Fields have the same meaning as in version 1; the magic number is still
+   0xDEADBEEF.
+*/
+typedef struct elf_hdr2 {
+    uint16_t e_version;     /* version should be 2 */
+    uint16_t e_hdrsize;     /* size of this header (48) */
+    uint32_t e_num_phdr;    /* number of program headers */
+    uint64_t e_entry;       /* entry point of program */
+    uint64_t e_phdr_start;  /* start of program headers (8-byte aligned) */
+    uint64_t e_symtab;      /* start of symbol table */
+    uint64_t e_strtab;      /* start of string table */
+    uint32_t e_phentsize;   /* size of one program header (32) */
+    uint32_t magic;         /* ELF */
+} elf_hdr2_t;
+
+typedef struct elf_phdr2 {
+    uint64_t p_offset;      /* beginning of the segment in the file (in bytes) */
+    uint64_t p_size;        /* number of bytes in the segment */
+    uint64_t p_vaddr;       /* intended virtual address of the segment */
+    uint16_t p_type;        /* segment type (e.g., code, data, etc.) */
+    uint16_t p_flags;       /* permissions flags */
+    uint32_t magic;         /* DEADBEEF */
+} elf_phdr2_t;
+
 #endif
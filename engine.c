@@ -0,0 +1,644 @@
+/*
+ * Pre-decoding execution engine
+ *
+ * Name: Griffin Moran
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+
+#include "engine.h"
+#include "p3-disas.h"
+#include "p4-interp.h"
+#include "predecode.h"
+#include "mem.h"
+#include "io.h"
+#include "ir.h"
+
+/*
+Number of bytes a decoded instruction was decoded from; an instruction
+recorded as invalid may depend on any of the ten bytes fetch looks at.
+*/
+static inline address_t decoded_span (y86_packed_t *packed)
+{
+    return packed -> stat != 0 ? 10 : packed -> len;
+}
+
+/*
+Drop the decoded instructions a store overlaps, including the ones breaks
+took out of the program.
+*/
+static void engine_invalidate (engine_t *eng, address_t addr, address_t len)
+{
+    invalidate_decoded(eng -> prog, addr, len);
+    if(eng -> brkSlot == NULL || addr >= MEMSIZE) {
+        return;
+    }
+    address_t start = addr > 9 ? addr - 9 : 0;
+    for(address_t a = start; a < addr + len && a < MEMSIZE; a++) {
+        int32_t slot = eng -> brkSlot[a];
+        if(slot >= 0 && a + decoded_span(&(eng -> prog -> insts[slot])) > addr) {
+            eng -> brkSlot[a] = -1;
+        }
+    }
+}
+
+/*
+Forward stores into code pages to the decoded program and its IR.
+*/
+static void engine_code_store (void *arg, address_t addr, address_t len)
+{
+    engine_t *eng = (engine_t*)arg;
+    engine_invalidate(eng, addr, len);
+    ir_invalidate(eng -> ir, addr, len);
+}
+
+/*
+Append an instruction to the decoded program unless its address already has
+one (overlapping segments decode the same bytes the same way).
+*/
+static void decode_add (y86_decoded_t *prog, address_t pc, y86_inst_t *ins, y86_stat_t stat)
+{
+    if(prog -> slot[pc] >= 0) {
+        return;
+    }
+
+    y86_packed_t packed = pack_inst(ins, pc);
+    if(stat == ADR || stat == INS) {
+        packed.stat = stat;
+        prog -> invalid++;
+    }
+    prog -> slot[pc] = prog -> count;
+    prog -> insts[prog -> count++] = packed;
+
+    //an invalid instruction still covers its first byte
+    address_t end = pc + (packed.len ? packed.len : 1);
+    if(pc < prog -> lo) {
+        prog -> lo = pc;
+    }
+    if(end > prog -> hi) {
+        prog -> hi = end;
+    }
+}
+
+bool decode_program (byte_t *memory, elf_phdr_t *phdrs, uint16_t numphdrs, y86_decoded_t *prog)
+{
+    if(memory == NULL || prog == NULL || (phdrs == NULL && numphdrs > 0)) {
+        return false;
+    }
+    memset(prog, 0, sizeof(y86_decoded_t));
+
+    //every instruction is at least one byte long
+    uint32_t capacity = 0;
+    for(int i = 0; i < numphdrs; i++) {
+        if(phdrs[i].p_type == CODE) {
+            capacity += phdrs[i].p_size;
+        }
+    }
+
+    prog -> slot = (int32_t*)malloc(MEMSIZE * sizeof(int32_t));
+    prog -> insts = (y86_packed_t*)malloc((capacity ? capacity : 1) * sizeof(y86_packed_t));
+    if(prog -> slot == NULL || prog -> insts == NULL) {
+        free(prog -> slot);
+        free(prog -> insts);
+        return false;
+    }
+    prog -> owned = true;
+    prog -> lo = MEMSIZE;
+    prog -> hi = 0;
+    for(int i = 0; i < MEMSIZE; i++) {
+        prog -> slot[i] = -1;
+    }
+
+    y86_soa_t soa;
+    y86_t cpu;
+    y86_inst_t ins;
+    for(int i = 0; i < numphdrs; i++) {
+        if(phdrs[i].p_type != CODE) {
+            continue;
+        }
+
+        //same walk as disassemble_code: stop at the first invalid instruction
+        if(!predecode_segment(memory, &phdrs[i], &soa)) {
+            free_decoded(prog);
+            return false;
+        }
+
+        for(uint32_t k = 0; k < soa.count; k++) {
+            ins = predecode_inst(&soa, k);
+            decode_add(prog, soa.pc[k], &ins, 0);
+        }
+
+        //record exactly what fetch makes of the instruction that ended the walk
+        if(soa.invalid) {
+            memset(&cpu, 0, sizeof(y86_t));
+            cpu.pc = soa.stop;
+            cpu.stat = AOK;
+            ins = fetch(&cpu, memory);
+            ins.valP = soa.stop;
+            decode_add(prog, soa.stop, &ins, cpu.stat);
+        }
+        free_soa(&soa);
+    }
+    return true;
+}
+
+void free_decoded (y86_decoded_t *prog)
+{
+    if(prog == NULL) {
+        return;
+    }
+
+    if(prog -> owned) {
+        free(prog -> insts);
+        free(prog -> slot);
+    }
+    memset(prog, 0, sizeof(y86_decoded_t));
+}
+
+void invalidate_decoded (y86_decoded_t *prog, address_t addr, address_t len)
+{
+    if(prog == NULL || prog -> slot == NULL || addr >= MEMSIZE) {
+        return;
+    }
+
+    //instructions are at most ten bytes, so anything starting up to nine
+    //bytes before the write may overlap it
+    address_t start = addr > 9 ? addr - 9 : 0;
+    address_t end = addr + len;
+
+    if(end <= prog -> lo || start >= prog -> hi) {
+        return;
+    }
+    if(end > MEMSIZE) {
+        end = MEMSIZE;
+    }
+
+    //drop only the instructions whose bytes the write actually overlaps
+    for(address_t a = start; a < end; a++) {
+        int32_t slot = prog -> slot[a];
+        if(slot >= 0 && a + decoded_span(&(prog -> insts[slot])) > addr) {
+            prog -> slot[a] = -1;
+            prog -> gen++;
+        }
+    }
+}
+
+void engine_init (engine_t *eng, y86_t *cpu, byte_t *memory, y86_decoded_t *prog)
+{
+    if(eng == NULL) {
+        return;
+    }
+    memset(eng, 0, sizeof(engine_t));
+    eng -> cpu = cpu;
+    eng -> memory = memory;
+    eng -> prog = prog;
+    eng -> predicted = -1;
+    eng -> checkAt = UINT64_MAX;
+
+    y86_mem_t *mem = mem_current;
+    if(prog == NULL || prog -> slot == NULL || mem == NULL) {
+        return;
+    }
+
+    //with permissions enforced, code on pages without X goes through fetch,
+    //and so does every invalid instruction: whether fetch reports ADR or INS
+    //depends on the X bits of all the bytes it would have taken
+    if(mem -> enforce) {
+        for(address_t a = prog -> lo; a < prog -> hi; a++) {
+            int32_t slot = prog -> slot[a];
+            if(slot >= 0 && (prog -> insts[slot].stat != 0 ||
+                             !mem_check(mem, a, prog -> insts[slot].len, PG_X))) {
+                prog -> slot[a] = -1;
+            }
+        }
+    }
+
+    //the page table's write barrier reports stores into decoded code
+    for(address_t a = prog -> lo; a < prog -> hi; a++) {
+        int32_t slot = prog -> slot[a];
+        if(slot >= 0) {
+            mem_mark_code(mem, a, decoded_span(&(prog -> insts[slot])));
+        }
+    }
+    mem -> onCode = engine_code_store;
+    mem -> onCodeArg = eng;
+    eng -> barrier = true;
+}
+
+/*
+Monotonic time in nanoseconds.
+*/
+static uint64_t engine_clock (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+Next count at which a limit has to be looked at.
+*/
+static void engine_arm (engine_t *eng)
+{
+    uint64_t at = UINT64_MAX;
+    if(eng -> deadline != 0) {
+        at = eng -> count + ENGINE_QUANTUM;
+    }
+    if(eng -> maxInsns != 0 && eng -> maxInsns < at) {
+        at = eng -> maxInsns;
+    }
+    if(eng -> tick != NULL && eng -> tickAt < at) {
+        at = eng -> tickAt;
+    }
+    eng -> checkAt = at;
+}
+
+void engine_limits (engine_t *eng, uint64_t maxInsns, double seconds)
+{
+    if(eng == NULL) {
+        return;
+    }
+    eng -> maxInsns = maxInsns;
+    eng -> deadline = 0;
+    eng -> limited = ENG_RUNNING;
+    eng -> watchHit = false;
+    if(seconds > 0) {
+        eng -> deadline = engine_clock() + (uint64_t)(seconds * 1e9);
+    }
+    engine_arm(eng);
+}
+
+void engine_tick (engine_t *eng, engine_tick_t tick, void *arg, uint64_t every)
+{
+    if(eng == NULL) {
+        return;
+    }
+    eng -> tick = tick;
+    eng -> tickArg = arg;
+    eng -> tickEvery = every > 0 ? every : 1;
+    eng -> tickAt = eng -> count + eng -> tickEvery;
+    engine_arm(eng);
+}
+
+/*
+Store into a PG_WATCH page: a block that did it ends right after the store,
+and the next poll ends the run.
+*/
+static void engine_watch_store (void *arg, address_t addr, address_t len)
+{
+    engine_t *eng = (engine_t*)arg;
+    for(address_t a = addr; a < addr + len && a < MEMSIZE; a++) {
+        if(eng -> watch[a]) {
+            eng -> watchHit = true;
+            eng -> watchAddr = a;
+            eng -> checkAt = 0;
+            if(eng -> ir != NULL) {
+                eng -> ir -> gen++;
+            }
+            return;
+        }
+    }
+}
+
+void engine_break (engine_t *eng, address_t addr, bool on)
+{
+    if(eng == NULL || addr >= MEMSIZE) {
+        return;
+    }
+    if(eng -> brk == NULL) {
+        if(!on) {
+            return;
+        }
+        eng -> brk = (uint8_t*)calloc(MEMSIZE, 1);
+        eng -> brkSlot = (int32_t*)malloc(MEMSIZE * sizeof(int32_t));
+        if(eng -> brk == NULL || eng -> brkSlot == NULL) {
+            free(eng -> brk);
+            free(eng -> brkSlot);
+            eng -> brk = NULL;
+            eng -> brkSlot = NULL;
+            return;
+        }
+    }
+    if(on == (eng -> brk[addr] != 0)) {
+        return;
+    }
+    eng -> brk[addr] = on;
+
+    //the instruction is fetched while the break is set; RET predictions
+    //made from its slot are dropped with the generation
+    y86_decoded_t *prog = eng -> prog;
+    bool decoded = prog != NULL && prog -> slot != NULL;
+    if(on) {
+        eng -> brkSlot[addr] = decoded ? prog -> slot[addr] : -1;
+        if(decoded && prog -> slot[addr] >= 0) {
+            prog -> slot[addr] = -1;
+            prog -> gen++;
+        }
+        eng -> predicted = -1;
+        ir_invalidate(eng -> ir, addr, 1);
+    } else if(decoded && eng -> brkSlot[addr] >= 0) {
+        prog -> slot[addr] = eng -> brkSlot[addr];
+    }
+}
+
+void engine_watch (engine_t *eng, address_t addr, address_t len, bool on)
+{
+    y86_mem_t *mem = mem_current;
+    if(eng == NULL || mem == NULL || len == 0 || addr >= MEMSIZE) {
+        return;
+    }
+    if(eng -> watch == NULL) {
+        if(!on) {
+            return;
+        }
+        eng -> watch = (uint8_t*)calloc(MEMSIZE, 1);
+        if(eng -> watch == NULL) {
+            return;
+        }
+    }
+    address_t end = addr + len < MEMSIZE && addr + len > addr ? addr + len : MEMSIZE;
+    for(address_t a = addr; a < end; a++) {
+        eng -> watch[a] = on;
+    }
+
+    //a page is watched while any of its bytes is
+    for(address_t p = addr >> PAGEBITS; p <= ((end - 1) >> PAGEBITS); p++) {
+        mem -> page[p] &= ~PG_WATCH;
+        for(address_t a = p << PAGEBITS; a < ((p + 1) << PAGEBITS); a++) {
+            if(eng -> watch[a]) {
+                mem -> page[p] |= PG_WATCH;
+                break;
+            }
+        }
+    }
+    mem -> onWatch = engine_watch_store;
+    mem -> onWatchArg = eng;
+}
+
+void engine_write (engine_t *eng, address_t addr, const byte_t *data, address_t len)
+{
+    if(eng == NULL || eng -> memory == NULL || data == NULL || addr >= MEMSIZE) {
+        return;
+    }
+    if(len > MEMSIZE - addr) {
+        len = MEMSIZE - addr;
+    }
+    if(len == 0) {
+        return;
+    }
+    y86_mem_t *mem = mem_current;
+    if(mem != NULL) {
+        mem_fault(addr, len);
+        for(address_t p = addr >> PAGEBITS; p <= ((addr + len - 1) >> PAGEBITS); p++) {
+            mem -> page[p] |= PG_DIRTY;
+        }
+    }
+    memcpy(eng -> memory + addr, data, len);
+    engine_invalidate(eng, addr, len);
+    ir_invalidate(eng -> ir, addr, len);
+    eng -> predicted = -1;
+}
+
+void engine_free (engine_t *eng)
+{
+    if(eng == NULL) {
+        return;
+    }
+    if(eng -> brk != NULL) {
+        for(address_t a = 0; a < MEMSIZE; a++) {
+            engine_break(eng, a, false);
+        }
+    }
+    y86_mem_t *mem = mem_current;
+    if(mem != NULL && mem -> onWatch == engine_watch_store && mem -> onWatchArg == eng) {
+        for(uint32_t p = 0; p < NUMPAGES; p++) {
+            mem -> page[p] &= ~PG_WATCH;
+        }
+        mem -> onWatch = NULL;
+    }
+    free(eng -> brk);
+    free(eng -> brkSlot);
+    free(eng -> watch);
+    eng -> brk = NULL;
+    eng -> brkSlot = NULL;
+    eng -> watch = NULL;
+    eng -> watchHit = false;
+}
+
+void engine_resume (engine_t *eng)
+{
+    if(eng == NULL) {
+        return;
+    }
+    eng -> limited = ENG_RUNNING;
+    eng -> watchHit = false;
+    engine_arm(eng);
+}
+
+bool engine_poll (engine_t *eng)
+{
+    if(eng -> limited != ENG_RUNNING) {
+        return true;
+    }
+    if(eng -> watchHit) {
+        eng -> watchHit = false;
+        eng -> limited = ENG_WATCH;
+        return true;
+    }
+    if(eng -> tick != NULL && eng -> count >= eng -> tickAt) {
+        eng -> tickAt = eng -> count + eng -> tickEvery;
+        eng -> tick(eng -> tickArg, eng);
+        if(eng -> limited != ENG_RUNNING) {
+            return true;
+        }
+    }
+    if(eng -> maxInsns != 0 && eng -> count >= eng -> maxInsns) {
+        eng -> limited = ENG_MAXINSNS;
+        return true;
+    }
+    if(eng -> deadline != 0 && engine_clock() >= eng -> deadline) {
+        eng -> limited = ENG_TIMEOUT;
+        return true;
+    }
+    engine_arm(eng);
+    return false;
+}
+
+/*
+IR to run blocks from: blocks retire many instructions at once, so only
+without observers.
+*/
+static inline ir_program_t *engine_blocks (engine_t *eng)
+{
+    ir_program_t *ir = eng -> ir;
+    if(ir == NULL || ir -> block == NULL || eng -> hook != NULL || !eng -> barrier ||
+            mem_current -> enforce) {
+        return NULL;
+    }
+    return ir;
+}
+
+/*
+The engine loop: each iteration runs the optimized block starting at the PC,
+if any, and otherwise the one instruction there. With once set, it stops
+after the first iteration.
+*/
+static void engine_loop (engine_t *eng, ir_program_t *ir, bool once)
+{
+    y86_t *cpu = eng -> cpu;
+    byte_t *memory = eng -> memory;
+    y86_decoded_t *prog = eng -> prog;
+    y86_inst_t inst;
+    bool cond = false;
+    y86_reg_t valA = 0;
+    y86_reg_t valE = 0;
+    address_t pc;
+    int32_t slot;
+    int32_t predicted = eng -> predicted;
+    engine_ret_t *ret;
+    ir_block_t *blk;
+
+    do {
+        //limits are only looked at when the count reaches the next check
+        if(eng -> count >= eng -> checkAt && engine_poll(eng)) {
+            break;
+        }
+        pc = cpu -> pc;
+
+        //the block hands back instructions it must not run itself; one that
+        //would run past the next check goes an instruction at a time
+        if(ir != NULL && predicted < 0 && pc < MEMSIZE && ir -> block[pc] >= 0) {
+            blk = &(ir -> blocks[ir -> block[pc]]);
+            if(eng -> checkAt - eng -> count >= blk -> count &&
+                    ir_run(ir, blk, cpu, memory, &(eng -> count))) {
+                continue;
+            }
+            pc = cpu -> pc;
+        }
+
+        //use the pre-decoded instruction when there is one
+        slot = -1;
+        if(predicted >= 0) {
+            slot = predicted;
+            predicted = -1;
+        } else if(prog != NULL && pc < MEMSIZE) {
+            slot = prog -> slot[pc];
+        }
+
+        if(slot >= 0) {
+            //verified at load time; invalid ones stop as fetch would
+            if(prog -> insts[slot].stat != 0) {
+                cpu -> stat = prog -> insts[slot].stat;
+                break;
+            }
+            inst = unpack_inst(&(prog -> insts[slot]), pc);
+        } else {
+            //breaks take their instructions out of the decoded program and
+            //its blocks, so only fetched instructions can hit one
+            if(eng -> brk != NULL && pc < MEMSIZE && eng -> brk[pc] && eng -> count != eng -> brkPass) {
+                eng -> limited = ENG_BREAK;
+                eng -> brkPass = eng -> count;
+                break;
+            }
+            inst = fetch(cpu, memory);
+            if(cpu -> stat == ADR || cpu -> stat == INS) {
+                break;
+            }
+        }
+
+        valE = decode_execute(cpu, &inst, &cond, &valA);
+        memory_wb_pc(cpu, &inst, memory, cond, valA, valE);
+
+        //an input trap left waiting for input, or for a deadline that
+        //passed first, did not retire
+        if(inst.icode == IOTRAP && io_current -> blocked) {
+            eng -> limited = io_current -> timedOut ? ENG_TIMEOUT : ENG_BLOCKED;
+            break;
+        }
+        eng -> count++;
+
+        //shadow return stack: CALL pushes, RET checks the real target
+        if(prog != NULL && cpu -> stat == AOK) {
+            if(inst.icode == CALL) {
+                ret = &(eng -> ras[eng -> rasTop++ % ENGINE_RAS]);
+                ret -> ret = inst.valP;
+                ret -> slot = inst.valP < MEMSIZE ? prog -> slot[inst.valP] : -1;
+                ret -> gen = prog -> gen;
+            } else if(inst.icode == RET) {
+                ret = NULL;
+                if(eng -> rasTop > 0) {
+                    ret = &(eng -> ras[--eng -> rasTop % ENGINE_RAS]);
+                }
+                if(ret != NULL && ret -> ret == cpu -> pc && ret -> gen == prog -> gen) {
+                    predicted = ret -> slot;
+                    eng -> retHits++;
+                } else {
+                    eng -> retMisses++;
+                }
+            }
+        }
+
+        //keep the decoded program coherent with self-modifying code when
+        //there is no page table to report stores into it
+        if(prog != NULL && !eng -> barrier) {
+            switch(inst.icode) {
+                case (RMMOVQ):
+                case (CALL):
+                case (PUSHQ):
+                    engine_invalidate(eng, valE, 8);
+                    break;
+
+                case (IOTRAP):
+                    if(inst.ifun.trap == CHARIN) {
+                        engine_invalidate(eng, cpu -> reg[RDI], 1);
+                    } else if(inst.ifun.trap == DECIN) {
+                        engine_invalidate(eng, cpu -> reg[RDI], 8);
+                    }
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        if(eng -> hook != NULL) {
+            eng -> hook(eng -> hookArg, pc, &inst, cond, cpu -> pc);
+        }
+    } while(!once && cpu -> stat == AOK);
+
+    eng -> predicted = predicted;
+}
+
+void engine_step (engine_t *eng, bool blocks)
+{
+    if(eng == NULL || eng -> cpu == NULL || eng -> memory == NULL || eng -> cpu -> stat != AOK ||
+            eng -> limited != ENG_RUNNING) {
+        return;
+    }
+    engine_loop(eng, blocks ? engine_blocks(eng) : NULL, true);
+}
+
+void engine_run (engine_t *eng)
+{
+    if(eng == NULL || eng -> cpu == NULL || eng -> memory == NULL || eng -> cpu -> stat != AOK ||
+            eng -> limited != ENG_RUNNING) {
+        return;
+    }
+    eng -> brkPass = eng -> count;
+    engine_loop(eng, engine_blocks(eng), false);
+    engine_finish(eng);
+}
+
+void engine_finish (engine_t *eng)
+{
+    if(eng == NULL) {
+        return;
+    }
+
+    //a run shorter than ENGINE_QUANTUM never looked at the clock
+    if(eng -> limited == ENG_RUNNING && eng -> deadline != 0 && engine_clock() >= eng -> deadline) {
+        eng -> limited = ENG_TIMEOUT;
+    }
+}
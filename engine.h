@@ -0,0 +1,312 @@
+#ifndef __CS261_ENGINE__
+#define __CS261_ENGINE__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "y86.h"
+#include "predecode.h"
+
+/* pre-decoded instructions of the code segments
+
+   Every instruction reached by walking a CODE segment from its start is
+   verified once at load time, so the engine runs it without any of the
+   checks fetch performs. The walk ends at the first invalid instruction,
+   which is kept as well together with the ADR or INS status fetch would
+   give it; the engine stops on it without fetching. Addresses with no
+   slot, and slots dropped because their bytes were written, go through
+   fetch with full checks. */
+typedef struct y86_decoded {
+
+    y86_packed_t *insts;        // decoded instructions in address order
+    uint32_t count;             // number of decoded instructions
+    uint32_t invalid;           //   of which cannot run (stat != 0)
+    int32_t *slot;              // MEMSIZE entries: index into insts of the
+                                // instruction starting at an address, or -1
+
+    address_t lo;               // lowest address covered by insts
+    address_t hi;               // one past the highest covered address
+
+    bool owned;                 // arrays were allocated by decode_program
+    uint64_t gen;               // bumped whenever slots are dropped
+
+} y86_decoded_t;
+
+/* shadow return stack depth (older entries are overwritten) */
+#define ENGINE_RAS 64
+
+/* return address pushed by CALL and the decoded instruction found there */
+typedef struct engine_ret {
+    address_t ret;              // address following the CALL
+    int32_t slot;               // slot of the instruction at ret, or -1
+    uint64_t gen;               // prog -> gen when slot was looked up
+} engine_ret_t;
+
+/* instructions run between two looks at the clock under a timeout */
+#define ENGINE_QUANTUM 65536
+
+/* limit or event that ended a run while the CPU status was still AOK */
+typedef enum {
+    ENG_RUNNING = 0, ENG_MAXINSNS, ENG_TIMEOUT, ENG_BREAK, ENG_WATCH, ENG_INTERRUPT,
+    ENG_BLOCKED
+} engine_limit_t;
+
+/* IR of the decoded program (see ir.h) */
+struct ir_program;
+
+/* called after every retired instruction when set */
+typedef void (*engine_hook_t) (void *arg, address_t pc, y86_inst_t *inst,
+                               bool cnd, address_t next);
+
+struct engine;
+
+/* called between two instructions every so many retired instructions */
+typedef void (*engine_tick_t) (void *arg, struct engine *eng);
+
+/* execution engine state */
+typedef struct engine {
+
+    y86_t *cpu;                 // CPU being run
+    byte_t *memory;             // Y86 address space
+    y86_decoded_t *prog;        // decoded code, or NULL to always fetch
+
+    uint64_t count;             // retired instructions
+
+    uint64_t maxInsns;          // instructions a run may retire (0 for no limit)
+    uint64_t deadline;          // monotonic time in ns the run must end by (0 for none)
+    uint64_t checkAt;           // count at which the limits are next looked at
+    engine_limit_t limited;     // limit that stopped the engine, if any
+
+    engine_tick_t tick;         // optional periodic callback
+    void *tickArg;              // argument passed to tick
+    uint64_t tickEvery;         // instructions between two ticks
+    uint64_t tickAt;            // count of the next tick
+
+    uint8_t *brk;               // MEMSIZE flags: stop before running the
+                                // instruction at an address, or NULL
+    int32_t *brkSlot;           // MEMSIZE decoded slots taken out of the
+                                // program by breaks (-1 if none or stale)
+    uint64_t brkPass;           // count at which breaks do not stop a run
+    uint8_t *watch;             // MEMSIZE flags: stop after a store into a
+                                // byte, or NULL
+    bool watchHit;              // a watched byte was just written
+    address_t watchAddr;        //   first watched byte it wrote
+
+    engine_ret_t ras[ENGINE_RAS];   // host-side shadow of the call stack
+    uint32_t rasTop;            // number of pushes minus pops
+    int32_t predicted;          // slot a RET found for the PC, or -1
+    uint64_t retHits;           // RETs that went straight to their successor
+    uint64_t retMisses;         // RETs whose target had to be looked up
+    bool barrier;               // the page table reports stores into
+                                // decoded code (see mem_store)
+
+    struct ir_program *ir;      // optimized blocks, or NULL
+
+    engine_hook_t hook;         // optional per-instruction observer
+    void *hookArg;              // argument passed to hook
+
+} engine_t;
+
+/**
+ * @brief Decode every instruction of the CODE segments of a loaded program
+ *
+ * @param memory Pointer to the beginning of the Y86 address space
+ * @param phdrs Program headers of the loaded program
+ * @param numphdrs Number of program headers
+ * @param prog Pointer to the decoded program to be populated
+ * @returns True if the tables could be allocated, false otherwise
+ */
+bool decode_program (byte_t *memory, elf_phdr_t *phdrs, uint16_t numphdrs, y86_decoded_t *prog);
+
+/**
+ * @brief Release a decoded program
+ *
+ * @param prog Decoded program to release
+ */
+void free_decoded (y86_decoded_t *prog);
+
+/**
+ * @brief Drop decoded instructions overlapping a range of written bytes
+ *
+ * @param prog Decoded program
+ * @param addr First byte written
+ * @param len Number of bytes written
+ */
+void invalidate_decoded (y86_decoded_t *prog, address_t addr, address_t len);
+
+/**
+ * @brief Prepare an engine for running a loaded program
+ *
+ * With a page table active, the pages holding decoded instructions are
+ * marked PG_CODE and the table's write barrier invalidates exactly the
+ * instructions a store overlaps, so programs that never write their code
+ * pay one page-bit test per store. When segment permissions are enforced,
+ * decoded instructions on pages that are not executable, and invalid ones,
+ * are dropped so fetch reports them, and read-only code can never be
+ * invalidated.
+ *
+ * @param eng Pointer to the engine
+ * @param cpu CPU to run, with the PC set to the entry point
+ * @param memory Pointer to the beginning of the Y86 address space
+ * @param prog Decoded program, or NULL
+ */
+void engine_init (engine_t *eng, y86_t *cpu, byte_t *memory, y86_decoded_t *prog);
+
+/**
+ * @brief Bound the runs of an engine
+ *
+ * The limits are not checked per instruction: the engine only compares its
+ * count against the next point of interest, which is the instruction limit
+ * or, under a timeout, the next multiple of ENGINE_QUANTUM instructions at
+ * which it reads the clock. A block that would retire past that point runs
+ * an instruction at a time, so the instruction limit is exact. The timeout
+ * is measured from this call. Input traps check it too (see io_read_char):
+ * one that is still waiting for input at the deadline ends the run with
+ * ENG_TIMEOUT, and so does a run found late by engine_finish.
+ *
+ * @param eng Pointer to the engine
+ * @param maxInsns Instructions the engine may retire in total (0 for no limit)
+ * @param seconds Wall-clock time the engine may run (0 for no limit)
+ */
+void engine_limits (engine_t *eng, uint64_t maxInsns, double seconds);
+
+/**
+ * @brief Call a function every so many retired instructions
+ *
+ * The tick is due at exact multiples of the interval counted from this
+ * call and is checked like the limits of engine_limits, so it costs
+ * nothing in between. It runs between two instructions with the CPU and
+ * memory in a consistent state, and may move eng -> tickAt to have the
+ * next call come earlier or later, or set eng -> limited (ENG_INTERRUPT)
+ * to end the run.
+ *
+ * @param eng Pointer to the engine
+ * @param tick Function to call, or NULL to remove the tick
+ * @param arg Argument passed to tick
+ * @param every Instructions between two calls (at least 1)
+ */
+void engine_tick (engine_t *eng, engine_tick_t tick, void *arg, uint64_t every);
+
+/**
+ * @brief Stop runs before the instruction at an address
+ *
+ * A run ends with ENG_BREAK, before retiring the instruction, whenever the
+ * PC reaches the address, except at the instruction engine_run started
+ * with and right after stopping there, so running or stepping again
+ * continues past the break. The break takes the instruction
+ * out of the decoded program and drops the optimized blocks covering it,
+ * so it is fetched and only fetched instructions look for breaks; every
+ * other instruction runs exactly as without breaks. Clearing the break
+ * puts the decoded instruction back unless its bytes were written in the
+ * meantime; the dropped blocks stay dropped.
+ *
+ * @param eng Pointer to the engine
+ * @param addr Address of the instruction
+ * @param on True to set the break, false to clear it
+ */
+void engine_break (engine_t *eng, address_t addr, bool on);
+
+/**
+ * @brief Stop runs after a store into a range of addresses
+ *
+ * A run ends with ENG_WATCH right after the instruction whose store wrote
+ * any of the bytes, with eng -> count including it. The pages holding
+ * watched bytes are marked PG_WATCH, so the page table's write barrier
+ * reports stores into them and other stores cost nothing more.
+ *
+ * @param eng Pointer to the engine
+ * @param addr First address watched
+ * @param len Number of bytes watched
+ * @param on True to watch the bytes, false to stop watching them
+ */
+void engine_watch (engine_t *eng, address_t addr, address_t len, bool on);
+
+/**
+ * @brief Write guest memory from outside the program
+ *
+ * Meant for debuggers: the decoded instructions and optimized blocks the
+ * bytes overlap are dropped and the pages are marked dirty, as for a store
+ * by the program, but watches are not told.
+ *
+ * @param eng Pointer to the engine
+ * @param addr First address to write
+ * @param data Bytes to write
+ * @param len Number of bytes (the write stops at the end of memory)
+ */
+void engine_write (engine_t *eng, address_t addr, const byte_t *data, address_t len);
+
+/**
+ * @brief Remove every break and watch of an engine and release their tables
+ *
+ * @param eng Pointer to the engine
+ */
+void engine_free (engine_t *eng);
+
+/**
+ * @brief Let an engine stopped by a limit, break or watch run again
+ *
+ * @param eng Pointer to the engine
+ */
+void engine_resume (engine_t *eng);
+
+/**
+ * @brief Do the work due once the count of an engine reached eng -> checkAt
+ *
+ * Reports a watched store, runs the tick if it is due, then checks the
+ * limits.
+ *
+ * @param eng Pointer to the engine
+ * @returns True if the run must end (the reason is in eng -> limited)
+ */
+bool engine_poll (engine_t *eng);
+
+/**
+ * @brief Run until the CPU status is no longer AOK or a limit is reached
+ *
+ * Instructions are taken from the decoded program where possible and from
+ * fetch otherwise; the results are identical to the fetch/decode_execute/
+ * memory_wb_pc loop. Each CALL records its return address and the decoded
+ * instruction there on a shadow stack; a RET whose real target (read from
+ * guest memory as always) matches the top entry continues with that
+ * instruction without looking it up, and falls back to the lookup
+ * otherwise. When the engine has an IR, no hook observes single
+ * instructions and permissions are not enforced, whole optimized blocks
+ * run through ir_run wherever one starts at the PC. A run that ends on
+ * one of the limits set by engine_limits leaves the status AOK and records
+ * the limit in eng -> limited. So does an input trap that blocks on input
+ * still to come (see y86_io_t): the run ends with ENG_BLOCKED before it,
+ * without retiring it, and running again retries it. A block hands such a
+ * trap back to be run on its own. The run ends with engine_finish.
+ *
+ * @param eng Pointer to the engine
+ */
+void engine_run (engine_t *eng);
+
+/**
+ * @brief Check the deadline once more at the end of a run
+ *
+ * A run that ended on its own (or stepped by engine_step) past the deadline
+ * set by engine_limits gets ENG_TIMEOUT, which the clock is otherwise only
+ * read for every ENGINE_QUANTUM instructions.
+ *
+ * @param eng Pointer to the engine
+ */
+void engine_finish (engine_t *eng);
+
+/**
+ * @brief Run the optimized block starting at the PC, or one instruction
+ *
+ * Does what one iteration of engine_run does; the number of instructions
+ * it retired is the difference in eng -> count. Nothing happens unless the
+ * CPU status is AOK and no limit has been reached.
+ *
+ * @param eng Pointer to the engine
+ * @param blocks False to run exactly one instruction even at a block start
+ */
+void engine_step (engine_t *eng, bool blocks);
+
+#endif
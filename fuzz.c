@@ -0,0 +1,90 @@
+/*
+ * In-process fuzz target for the loader and the execution engines
+ *
+ * Build with "make fuzz" (libFuzzer, needs clang) or "make fuzz-replay"
+ * (runs the files named on the command line once, with any compiler).
+ *
+ * Name: Griffin Moran
+ */
+
+#include "fuzz.h"
+#include "image.h"
+#include "difftest.h"
+#include "io.h"
+
+static byte_t *fuzzMemory = NULL;
+
+int fuzz_one (const byte_t *data, size_t size, const byte_t *input, size_t inputLen,
+              uint64_t budget)
+{
+    elf_image_t image;
+    if(data == NULL) {
+        return 0;
+    }
+    if(image_borrow(data, size, &image) != IMG_OK) {
+        image_close(&image);
+        return 0;
+    }
+
+    //one address space for every run; clearing it is the whole reset
+    if(fuzzMemory == NULL) {
+        fuzzMemory = (byte_t*)malloc(MEMSIZE);
+        if(fuzzMemory == NULL) {
+            image_close(&image);
+            return 0;
+        }
+    }
+    memset(fuzzMemory, 0, MEMSIZE);
+    image_load(&image, fuzzMemory);
+
+    y86_io_t *saved = io_current;
+    y86_io_t io;
+    io_init_buffer(&io, input, inputLen);
+    io_current = &io;
+
+    y86_t cpu;
+    if(!difftest_program(fuzzMemory, image.phdrs, image.hdr.e_num_phdr, image.hdr2.e_entry,
+                         budget, &cpu, NULL)) {
+        fflush(stdout);
+        abort();
+    }
+
+    io_current = saved;
+    image_close(&image);
+    return cpu.stat;
+}
+
+#ifdef Y86_FUZZ
+
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size);
+
+/*
+libFuzzer entry point; the input traps read the image's own bytes.
+*/
+int LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+    fuzz_one(data, size, data, size, FUZZ_BUDGET);
+    return 0;
+}
+
+#ifdef Y86_FUZZ_MAIN
+
+/*
+Replay driver for builds without libFuzzer.
+*/
+int main (int argc, char **argv)
+{
+    for(int i = 1; i < argc; i++) {
+        elf_image_t image;
+        if(image_map(argv[i], &image) != IMG_OK) {
+            printf("Failed to read %s\n", argv[i]);
+            continue;
+        }
+        LLVMFuzzerTestOneInput(image.data, image.size);
+        image_close(&image);
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif
+#endif
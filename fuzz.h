@@ -0,0 +1,37 @@
+#ifndef __CS261_FUZZ__
+#define __CS261_FUZZ__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+
+/* instructions a fuzz input may retire before it is cut off */
+#define FUZZ_BUDGET 10000
+
+/**
+ * @brief Load a Mini-ELF image from a buffer and run it
+ *
+ * The image is validated and loaded straight from the buffer, decoded and
+ * optimized, then run by the engine in lockstep with the reference
+ * interpreter (see difftest_run). The I/O traps read the input bytes and
+ * drop their output, so nothing touches stdio unless the engines diverge,
+ * in which case the divergence is printed and the process aborts so that a
+ * fuzzer reports it like any other crash. The address space is reused
+ * between calls and only cleared.
+ *
+ * @param data Bytes of the image
+ * @param size Number of bytes
+ * @param input Bytes read by the input traps
+ * @param inputLen Number of input bytes
+ * @param budget Maximum number of instructions to run (0 for no limit)
+ * @returns Final CPU status (AOK if the budget ran out), or 0 if the buffer
+ * is not a valid Mini-ELF
+ */
+int fuzz_one (const byte_t *data, size_t size, const byte_t *input, size_t inputLen,
+              uint64_t budget);
+
+#endif
@@ -0,0 +1,670 @@
+/*
+ * GDB remote serial protocol stub
+ *
+ * Name: Griffin Moran
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "gdb.h"
+#include "mem.h"
+#include "io.h"
+
+/* registers in the order of the g packet and their register numbers */
+static const char gdbTarget[] =
+    "<?xml version=\"1.0\"?>\n"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+    "<target version=\"1.0\">\n"
+    "  <feature name=\"org.cs261.y86.core\">\n"
+    "    <flags id=\"y86_flags\" size=\"4\">\n"
+    "      <field name=\"ZF\" start=\"6\" end=\"6\"/>\n"
+    "      <field name=\"SF\" start=\"7\" end=\"7\"/>\n"
+    "      <field name=\"OF\" start=\"11\" end=\"11\"/>\n"
+    "    </flags>\n"
+    "    <reg name=\"rax\" bitsize=\"64\" type=\"int64\" regnum=\"0\"/>\n"
+    "    <reg name=\"rcx\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"rdx\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"rbx\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"rsp\" bitsize=\"64\" type=\"data_ptr\"/>\n"
+    "    <reg name=\"rbp\" bitsize=\"64\" type=\"data_ptr\"/>\n"
+    "    <reg name=\"rsi\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"rdi\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"r8\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"r9\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"r10\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"r11\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"r12\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"r13\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"r14\" bitsize=\"64\" type=\"int64\"/>\n"
+    "    <reg name=\"pc\" bitsize=\"64\" type=\"code_ptr\"/>\n"
+    "    <reg name=\"eflags\" bitsize=\"32\" type=\"y86_flags\"/>\n"
+    "    <reg name=\"stat\" bitsize=\"32\" type=\"int32\"/>\n"
+    "  </feature>\n"
+    "</target>\n";
+
+static const char gdbHex[] = "0123456789abcdef";
+
+/*
+Value of a hex digit, or -1.
+*/
+static int gdb_hexval (int c)
+{
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/*
+Parse a hex number and move past it; false if there are no digits.
+*/
+static bool gdb_number (const char **p, uint64_t *v)
+{
+    const char *s = *p;
+    uint64_t value = 0;
+    while(gdb_hexval(*s) >= 0) {
+        value = (value << 4) | (uint64_t)gdb_hexval(*s);
+        s++;
+    }
+    if(s == *p) {
+        return false;
+    }
+    *p = s;
+    *v = value;
+    return true;
+}
+
+/*
+Write a value as little-endian hex bytes (target byte order).
+*/
+static char *gdb_put_le (char *out, uint64_t v, int bytes)
+{
+    for(int i = 0; i < bytes; i++) {
+        byte_t b = (byte_t)(v >> (8 * i));
+        *out++ = gdbHex[b >> 4];
+        *out++ = gdbHex[b & 0xf];
+    }
+    *out = '\0';
+    return out;
+}
+
+/*
+Read a value from little-endian hex bytes and move past them.
+*/
+static bool gdb_get_le (const char **p, int bytes, uint64_t *v)
+{
+    const char *s = *p;
+    uint64_t value = 0;
+    for(int i = 0; i < bytes; i++) {
+        int hi = gdb_hexval(s[0]);
+        int lo = hi >= 0 ? gdb_hexval(s[1]) : -1;
+        if(lo < 0) {
+            return false;
+        }
+        value |= (uint64_t)((hi << 4) | lo) << (8 * i);
+        s += 2;
+    }
+    *p = s;
+    *v = value;
+    return true;
+}
+
+/*
+Register by number of the target description, and its size in bytes.
+*/
+static uint64_t gdb_reg (y86_t *cpu, int n, int *bytes)
+{
+    *bytes = n < GDB_FLAGS ? 8 : 4;
+    if(n < NUMREGS) {
+        return cpu -> reg[n];
+    }
+    if(n == GDB_PC) {
+        return cpu -> pc;
+    }
+    if(n == GDB_FLAGS) {
+        return ((uint64_t)cpu -> zf << 6) | ((uint64_t)cpu -> sf << 7) | ((uint64_t)cpu -> of << 11);
+    }
+    return (uint64_t)cpu -> stat;
+}
+
+/*
+Set a register by number; the status cannot be written.
+*/
+static void gdb_set_reg (engine_t *eng, int n, uint64_t v)
+{
+    y86_t *cpu = eng -> cpu;
+    if(n < NUMREGS) {
+        cpu -> reg[n] = v;
+    } else if(n == GDB_PC) {
+        //a RET prediction was for the old PC
+        cpu -> pc = v;
+        eng -> predicted = -1;
+    } else if(n == GDB_FLAGS) {
+        cpu -> zf = (v >> 6) & 1;
+        cpu -> sf = (v >> 7) & 1;
+        cpu -> of = (v >> 11) & 1;
+    }
+}
+
+/*
+Next byte from the debugger, or -1 once the connection is gone.
+*/
+static int gdb_getc (gdb_t *gdb)
+{
+    if(gdb -> rpos == gdb -> rlen) {
+        ssize_t n;
+        do {
+            n = recv(gdb -> fd, gdb -> rbuf, sizeof(gdb -> rbuf), 0);
+        } while(n < 0 && errno == EINTR);
+        if(n <= 0) {
+            return -1;
+        }
+        gdb -> rpos = 0;
+        gdb -> rlen = (size_t)n;
+    }
+    return (byte_t)gdb -> rbuf[gdb -> rpos++];
+}
+
+/*
+Send bytes as they are.
+*/
+static bool gdb_write (gdb_t *gdb, const char *buf, size_t len)
+{
+    while(len > 0) {
+        ssize_t n = send(gdb -> fd, buf, len, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/*
+Take the next packet into gdb -> in, acknowledging it; false once the
+connection is gone. Interrupts sent while the program is stopped are
+dropped.
+*/
+static bool gdb_recv (gdb_t *gdb)
+{
+    while(true) {
+        int c;
+        do {
+            c = gdb_getc(gdb);
+            if(c < 0) {
+                return false;
+            }
+        } while(c != '$');
+
+        size_t len = 0;
+        byte_t sum = 0;
+        bool over = false;
+        while((c = gdb_getc(gdb)) != '#') {
+            if(c < 0) {
+                return false;
+            }
+            if(c == '$') {
+                //a new packet started before this one ended
+                len = 0;
+                sum = 0;
+                over = false;
+                continue;
+            }
+            sum += (byte_t)c;
+            if(len < GDB_PACKET) {
+                gdb -> in[len++] = (char)c;
+            } else {
+                over = true;
+            }
+        }
+        int hi = gdb_hexval(gdb_getc(gdb));
+        int lo = gdb_hexval(gdb_getc(gdb));
+        bool ok = !over && hi >= 0 && lo >= 0 && ((hi << 4) | lo) == sum;
+        if(!gdb -> noAck && !gdb_write(gdb, ok ? "+" : "-", 1)) {
+            return false;
+        }
+        if(ok) {
+            gdb -> in[len] = '\0';
+            return true;
+        }
+    }
+}
+
+/*
+Send a packet, again until the debugger acknowledges it.
+*/
+static bool gdb_send (gdb_t *gdb, const char *data)
+{
+    static char frame[2 * GDB_PACKET + 8];
+    size_t len = strlen(data);
+    byte_t sum = 0;
+    for(size_t i = 0; i < len; i++) {
+        sum += (byte_t)data[i];
+    }
+    frame[0] = '$';
+    memcpy(frame + 1, data, len);
+    frame[len + 1] = '#';
+    frame[len + 2] = gdbHex[sum >> 4];
+    frame[len + 3] = gdbHex[sum & 0xf];
+
+    while(true) {
+        if(!gdb_write(gdb, frame, len + 4)) {
+            return false;
+        }
+        if(gdb -> noAck) {
+            return true;
+        }
+        int c;
+        do {
+            c = gdb_getc(gdb);
+        } while(c >= 0 && c != '+' && c != '-');
+        if(c != '-') {
+            return c == '+';
+        }
+    }
+}
+
+/*
+Engine tick while continuing: a byte from the debugger (its interrupt) or
+a closed connection stops the run.
+*/
+static void gdb_tick (void *arg, engine_t *eng)
+{
+    gdb_t *gdb = (gdb_t*)arg;
+    if(gdb -> rpos == gdb -> rlen) {
+        struct pollfd pfd;
+        pfd.fd = gdb -> fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if(poll(&pfd, 1, 0) <= 0) {
+            return;
+        }
+    }
+    gdb_getc(gdb);
+    eng -> limited = ENG_INTERRUPT;
+}
+
+/*
+Reply telling why the program stopped.
+*/
+static void gdb_stop_reply (gdb_t *gdb)
+{
+    engine_t *eng = gdb -> eng;
+    switch(eng -> cpu -> stat) {
+        case (HLT):
+            strcpy(gdb -> out, "W00");
+            return;
+
+        case (ADR):
+            strcpy(gdb -> out, "S0b");
+            return;
+
+        case (INS):
+            strcpy(gdb -> out, "S04");
+            return;
+
+        default:
+            break;
+    }
+    if(eng -> limited == ENG_WATCH) {
+        snprintf(gdb -> out, sizeof(gdb -> out), "T05watch:%" PRIx64 ";", eng -> watchAddr);
+    } else if(eng -> limited == ENG_INTERRUPT) {
+        strcpy(gdb -> out, "S02");
+    } else {
+        strcpy(gdb -> out, "S05");
+    }
+}
+
+/*
+Memory read (m addr,len): as much of the range as lies in memory.
+*/
+static void gdb_read_memory (gdb_t *gdb, const char *p)
+{
+    uint64_t addr;
+    uint64_t len;
+    if(!gdb_number(&p, &addr) || *p++ != ',' || !gdb_number(&p, &len) || addr >= MEMSIZE) {
+        strcpy(gdb -> out, "E01");
+        return;
+    }
+    if(len > MEMSIZE - addr) {
+        len = MEMSIZE - addr;
+    }
+    if(len > GDB_PACKET / 2) {
+        len = GDB_PACKET / 2;
+    }
+    if(len > 0 && mem_current != NULL) {
+        mem_fault(addr, len);
+    }
+    char *out = gdb -> out;
+    for(uint64_t i = 0; i < len; i++) {
+        out = gdb_put_le(out, gdb -> eng -> memory[addr + i], 1);
+    }
+    *out = '\0';
+}
+
+/*
+Memory write (M addr,len:bytes).
+*/
+static void gdb_write_memory (gdb_t *gdb, const char *p)
+{
+    static byte_t data[GDB_PACKET / 2];
+    uint64_t addr;
+    uint64_t len;
+    if(!gdb_number(&p, &addr) || *p++ != ',' || !gdb_number(&p, &len) || *p++ != ':' ||
+            len > sizeof(data) || addr >= MEMSIZE || len > MEMSIZE - addr) {
+        strcpy(gdb -> out, "E01");
+        return;
+    }
+    for(uint64_t i = 0; i < len; i++) {
+        uint64_t b;
+        if(!gdb_get_le(&p, 1, &b)) {
+            strcpy(gdb -> out, "E01");
+            return;
+        }
+        data[i] = (byte_t)b;
+    }
+    engine_write(gdb -> eng, addr, data, len);
+    strcpy(gdb -> out, "OK");
+}
+
+/*
+Set or remove a breakpoint or write watchpoint (Z/z type,addr,kind).
+*/
+static void gdb_point (gdb_t *gdb, const char *p, bool on)
+{
+    uint64_t type;
+    uint64_t addr;
+    uint64_t kind;
+    if(!gdb_number(&p, &type) || *p++ != ',' || !gdb_number(&p, &addr) || *p++ != ',' ||
+            !gdb_number(&p, &kind) || addr >= MEMSIZE) {
+        strcpy(gdb -> out, "E01");
+        return;
+    }
+    if(type == 0 || type == 1) {
+        engine_break(gdb -> eng, addr, on);
+    } else if(type == 2 && kind > 0) {
+        engine_watch(gdb -> eng, addr, kind, on);
+    } else {
+        //read and access watchpoints are not supported
+        gdb -> out[0] = '\0';
+        return;
+    }
+    strcpy(gdb -> out, "OK");
+}
+
+/*
+Queries (q...): features, the target description and the single thread.
+*/
+static void gdb_query (gdb_t *gdb, const char *q)
+{
+    const char *xfer = "qXfer:features:read:target.xml:";
+    if(strncmp(q, "qSupported", 10) == 0) {
+        snprintf(gdb -> out, sizeof(gdb -> out),
+                 "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+", GDB_PACKET);
+    } else if(strncmp(q, xfer, strlen(xfer)) == 0) {
+        const char *p = q + strlen(xfer);
+        uint64_t off;
+        uint64_t len;
+        if(!gdb_number(&p, &off) || *p++ != ',' || !gdb_number(&p, &len)) {
+            strcpy(gdb -> out, "E01");
+            return;
+        }
+        uint64_t size = sizeof(gdbTarget) - 1;
+        if(off >= size) {
+            strcpy(gdb -> out, "l");
+            return;
+        }
+        if(len > GDB_PACKET - 1) {
+            len = GDB_PACKET - 1;
+        }
+        if(len > size - off) {
+            len = size - off;
+        }
+        gdb -> out[0] = off + len < size ? 'm' : 'l';
+        memcpy(gdb -> out + 1, gdbTarget + off, len);
+        gdb -> out[len + 1] = '\0';
+    } else if(strncmp(q, "qXfer:", 6) == 0) {
+        strcpy(gdb -> out, "E00");
+    } else if(strcmp(q, "qAttached") == 0) {
+        strcpy(gdb -> out, "1");
+    } else if(strcmp(q, "qC") == 0) {
+        strcpy(gdb -> out, "QC1");
+    } else if(strcmp(q, "qfThreadInfo") == 0) {
+        strcpy(gdb -> out, "m1");
+    } else if(strcmp(q, "qsThreadInfo") == 0) {
+        strcpy(gdb -> out, "l");
+    } else if(strncmp(q, "qSymbol", 7) == 0) {
+        strcpy(gdb -> out, "OK");
+    } else {
+        gdb -> out[0] = '\0';
+    }
+}
+
+/*
+Run the program at full speed until it stops, hits a break or watch, or
+the debugger interrupts it.
+*/
+static void gdb_continue (gdb_t *gdb)
+{
+    engine_t *eng = gdb -> eng;
+    engine_limits(eng, 0, 0);
+    engine_tick(eng, gdb_tick, gdb, GDB_POLL);
+    engine_run(eng);
+    engine_tick(eng, NULL, NULL, 1);
+}
+
+/*
+Run one instruction, even one with a break on it.
+*/
+static void gdb_step (gdb_t *gdb)
+{
+    engine_t *eng = gdb -> eng;
+    engine_limits(eng, 0, 0);
+    eng -> brkPass = eng -> count;
+    engine_step(eng, false);
+    if(eng -> watchHit) {
+        eng -> watchHit = false;
+        eng -> limited = ENG_WATCH;
+    }
+}
+
+/*
+Answer one packet; false once the session is over.
+*/
+static bool gdb_handle (gdb_t *gdb)
+{
+    engine_t *eng = gdb -> eng;
+    y86_t *cpu = eng -> cpu;
+    const char *p = gdb -> in + 1;
+    char *out = gdb -> out;
+    uint64_t n;
+    uint64_t v;
+    int bytes;
+
+    out[0] = '\0';
+    switch(gdb -> in[0]) {
+        case ('?'):
+            gdb_stop_reply(gdb);
+            break;
+
+        case ('g'):
+            for(int r = 0; r < GDB_NUMREGS; r++) {
+                v = gdb_reg(cpu, r, &bytes);
+                out = gdb_put_le(out, v, bytes);
+            }
+            break;
+
+        case ('G'):
+            for(int r = 0; r < GDB_NUMREGS; r++) {
+                gdb_reg(cpu, r, &bytes);
+                if(!gdb_get_le(&p, bytes, &v)) {
+                    break;
+                }
+                gdb_set_reg(eng, r, v);
+            }
+            strcpy(out, "OK");
+            break;
+
+        case ('p'):
+            if(!gdb_number(&p, &n) || n >= GDB_NUMREGS) {
+                strcpy(out, "E01");
+                break;
+            }
+            v = gdb_reg(cpu, (int)n, &bytes);
+            gdb_put_le(out, v, bytes);
+            break;
+
+        case ('P'):
+            if(!gdb_number(&p, &n) || *p++ != '=' || n >= GDB_NUMREGS) {
+                strcpy(out, "E01");
+                break;
+            }
+            gdb_reg(cpu, (int)n, &bytes);
+            if(!gdb_get_le(&p, bytes, &v)) {
+                strcpy(out, "E01");
+                break;
+            }
+            gdb_set_reg(eng, (int)n, v);
+            strcpy(out, "OK");
+            break;
+
+        case ('m'):
+            gdb_read_memory(gdb, p);
+            break;
+
+        case ('M'):
+            gdb_write_memory(gdb, p);
+            break;
+
+        case ('c'):
+        case ('s'):
+            //an address to resume at may follow
+            if(gdb_number(&p, &v)) {
+                gdb_set_reg(eng, GDB_PC, v);
+            }
+            if(gdb -> in[0] == 'c') {
+                gdb_continue(gdb);
+            } else {
+                gdb_step(gdb);
+            }
+            gdb_stop_reply(gdb);
+            break;
+
+        case ('Z'):
+        case ('z'):
+            gdb_point(gdb, p, gdb -> in[0] == 'Z');
+            break;
+
+        case ('q'):
+            gdb_query(gdb, gdb -> in);
+            break;
+
+        case ('Q'):
+            if(strcmp(gdb -> in, "QStartNoAckMode") == 0) {
+                //the OK itself is still acknowledged
+                bool sent = gdb_send(gdb, "OK");
+                gdb -> noAck = true;
+                return sent;
+            }
+            break;
+
+        case ('H'):
+        case ('T'):
+            strcpy(out, "OK");
+            break;
+
+        case ('D'):
+            gdb -> detached = true;
+            gdb_send(gdb, "OK");
+            return false;
+
+        case ('k'):
+            return false;
+
+        case ('v'):
+            if(strcmp(gdb -> in, "vKill") == 0 || strncmp(gdb -> in, "vKill;", 6) == 0) {
+                gdb_send(gdb, "OK");
+                return false;
+            }
+            break;
+
+        default:
+            break;
+    }
+    return gdb_send(gdb, gdb -> out);
+}
+
+bool gdb_listen (gdb_t *gdb, const char *where)
+{
+    if(gdb == NULL) {
+        return false;
+    }
+    memset(gdb, 0, sizeof(gdb_t));
+    gdb -> fd = -1;
+    gdb -> listenFd = io_listen(where, 1, gdb -> path, sizeof(gdb -> path));
+    return gdb -> listenFd >= 0;
+}
+
+void gdb_serve (gdb_t *gdb, engine_t *eng)
+{
+    if(gdb == NULL || eng == NULL || gdb -> listenFd < 0) {
+        return;
+    }
+    gdb -> eng = eng;
+    do {
+        gdb -> fd = accept(gdb -> listenFd, NULL, NULL);
+    } while(gdb -> fd < 0 && errno == EINTR);
+    if(gdb -> fd < 0) {
+        return;
+    }
+
+    //replies are small and waited for; fails harmlessly on Unix sockets
+    int one = 1;
+    setsockopt(gdb -> fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    while(gdb_recv(gdb) && gdb_handle(gdb)) {
+    }
+    close(gdb -> fd);
+    gdb -> fd = -1;
+
+    if(gdb -> detached) {
+        engine_limits(eng, 0, 0);
+        engine_run(eng);
+    }
+}
+
+void gdb_close (gdb_t *gdb)
+{
+    if(gdb == NULL) {
+        return;
+    }
+    if(gdb -> fd >= 0) {
+        close(gdb -> fd);
+        gdb -> fd = -1;
+    }
+    if(gdb -> listenFd >= 0) {
+        close(gdb -> listenFd);
+        gdb -> listenFd = -1;
+    }
+    if(gdb -> path[0] != '\0') {
+        unlink(gdb -> path);
+        gdb -> path[0] = '\0';
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef __CS261_GDB__
+#define __CS261_GDB__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+#include "engine.h"
+
+/* largest packet payload taken or sent */
+#define GDB_PACKET 4096
+
+/* instructions between two looks for an interrupt from the debugger */
+#define GDB_POLL ENGINE_QUANTUM
+
+/* register numbers of the target description (see gdb.c) */
+#define GDB_PC NUMREGS          // pc, 64 bits
+#define GDB_FLAGS (NUMREGS + 1) // eflags, 32 bits (ZF bit 6, SF bit 7, OF bit 11)
+#define GDB_STAT (NUMREGS + 2)  // stat, 32 bits (read only)
+#define GDB_NUMREGS (NUMREGS + 3)
+
+/* GDB remote serial protocol stub serving one debugger connection
+
+   The stub answers the packets gdb needs to debug a program: registers
+   (described to gdb by a target description), memory, single steps,
+   continue, software and hardware breakpoints and write watchpoints.
+   Continuing runs the engine at full speed and only looks at the
+   connection for an interrupt every GDB_POLL instructions. */
+typedef struct gdb {
+
+    int listenFd;               // listening socket, or -1
+    int fd;                     // connection to the debugger, or -1
+    char path[108];             // Unix socket file to remove, or ""
+
+    engine_t *eng;              // engine being debugged
+    bool noAck;                 // packets are no longer acknowledged
+    bool detached;              // the debugger let the program run on
+
+    char rbuf[GDB_PACKET];      // bytes received and not yet taken
+    size_t rpos;
+    size_t rlen;
+
+    char in[GDB_PACKET + 1];    // payload of the last packet
+    char out[2 * GDB_PACKET + 1];   // payload of the reply
+
+} gdb_t;
+
+/**
+ * @brief Listen for a debugger
+ *
+ * A name made only of digits is a TCP port on the loopback interface;
+ * anything else is the path of a Unix socket.
+ *
+ * @param gdb Pointer to the stub
+ * @param where Port number or socket path
+ * @returns True if the socket is listening, false otherwise
+ */
+bool gdb_listen (gdb_t *gdb, const char *where);
+
+/**
+ * @brief Wait for a debugger and serve it until it detaches, kills the
+ * program or goes away
+ *
+ * A program the debugger detached from runs on to the end.
+ *
+ * @param gdb Pointer to the listening stub
+ * @param eng Engine of the program, stopped at its first instruction
+ */
+void gdb_serve (gdb_t *gdb, engine_t *eng);
+
+/**
+ * @brief Close the sockets of the stub
+ *
+ * @param gdb Pointer to the stub
+ */
+void gdb_close (gdb_t *gdb);
+
+#endif
@@ -0,0 +1,293 @@
+/*
+ * Memory-mapped Mini-ELF loader
+ *
+ * Name: Griffin Moran
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+
+/*
+Read a stream forward until end-of-file into a heap buffer.
+*/
+static image_stat_t read_all (FILE *stream, elf_image_t *img)
+{
+    size_t capacity = 4096;
+    byte_t *buffer = (byte_t*)malloc(capacity);
+    if(buffer == NULL) {
+        return IMG_IOERR;
+    }
+
+    //read forward until end-of-file, doubling the buffer as needed
+    size_t size = 0;
+    size_t got;
+    while((got = fread(buffer + size, 1, capacity - size, stream)) > 0) {
+        size += got;
+        if(size == capacity) {
+            byte_t *bigger = (byte_t*)realloc(buffer, capacity * 2);
+            if(bigger == NULL) {
+                free(buffer);
+                return IMG_IOERR;
+            }
+            buffer = bigger;
+            capacity *= 2;
+        }
+    }
+
+    if(ferror(stream)) {
+        free(buffer);
+        return IMG_IOERR;
+    }
+
+    img -> data = buffer;
+    img -> size = size;
+    img -> mapped = false;
+    return IMG_OK;
+}
+
+image_stat_t image_map (const char *filename, elf_image_t *img)
+{
+    if(filename == NULL || img == NULL) {
+        return IMG_IOERR;
+    }
+    memset(img, 0, sizeof(elf_image_t));
+
+    if(strcmp(filename, "-") == 0) {
+        return read_all(stdin, img);
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        return IMG_IOERR;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return IMG_IOERR;
+    }
+
+    //only regular files can be mapped
+    if(!S_ISREG(st.st_mode)) {
+        FILE *stream = fdopen(fd, "r");
+        if(stream == NULL) {
+            close(fd);
+            return IMG_IOERR;
+        }
+        image_stat_t status = read_all(stream, img);
+        fclose(stream);
+        return status;
+    }
+
+    //too short for a header (and empty files cannot be mapped)
+    if(st.st_size < (off_t)sizeof(elf_hdr_t)) {
+        close(fd);
+        return IMG_BADHDR;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return IMG_IOERR;
+    }
+
+    img -> data = (byte_t*)data;
+    img -> size = st.st_size;
+    img -> mapped = true;
+    return IMG_OK;
+}
+
+image_stat_t image_borrow (const byte_t *data, size_t size, elf_image_t *img)
+{
+    if(data == NULL || img == NULL) {
+        return IMG_IOERR;
+    }
+    memset(img, 0, sizeof(elf_image_t));
+
+    img -> data = (byte_t*)data;
+    img -> size = size;
+    img -> borrowed = true;
+    return image_parse(img);
+}
+
+/*
+Check the bounds of one segment, same as load_segment.
+*/
+static bool image_check_segment (elf_image_t *img, uint64_t offset, uint64_t size,
+                                 uint64_t vaddr, uint16_t type)
+{
+    if(size == 0) {
+        return true;
+    }
+    return vaddr + size <= MEMSIZE && size <= MEMSIZE &&
+           (type == DATA || type == CODE || type == STACK) &&
+           offset <= img -> size && size <= img -> size - offset;
+}
+
+/*
+Validate a version 2 image directly over its aligned program header table
+and build the narrowed version 1 view of it.
+*/
+static image_stat_t image_parse2 (elf_image_t *img)
+{
+    if(img -> size < sizeof(elf_hdr2_t)) {
+        return IMG_BADHDR;
+    }
+    memcpy(&(img -> hdr2), img -> data, sizeof(elf_hdr2_t));
+    elf_hdr2_t *hdr2 = &(img -> hdr2);
+
+    if(hdr2 -> e_hdrsize != sizeof(elf_hdr2_t) || hdr2 -> e_phentsize != sizeof(elf_phdr2_t) ||
+            hdr2 -> magic != 0x464C45 || hdr2 -> e_phdr_start % 8 != 0 ||
+            hdr2 -> e_num_phdr > UINT16_MAX) {
+        return IMG_BADHDR;
+    }
+
+    //the table is used in place, so it has to be present and aligned
+    if(hdr2 -> e_phdr_start > img -> size ||
+            (img -> size - hdr2 -> e_phdr_start) / sizeof(elf_phdr2_t) < hdr2 -> e_num_phdr) {
+        return IMG_BADPHDR;
+    }
+    img -> phdrs2 = (elf_phdr2_t*)(img -> data + hdr2 -> e_phdr_start);
+
+    image_stat_t segStat = IMG_OK;
+    for(uint32_t i = 0; i < hdr2 -> e_num_phdr; i++) {
+        elf_phdr2_t *phdr = &(img -> phdrs2[i]);
+        if(phdr -> p_vaddr > MEMSIZE || phdr -> magic != 0xDEADBEEF) {
+            return IMG_BADPHDR;
+        }
+        if(!image_check_segment(img, phdr -> p_offset, phdr -> p_size, phdr -> p_vaddr, phdr -> p_type)) {
+            segStat = IMG_BADSEG;
+        }
+    }
+    if(segStat != IMG_OK) {
+        return segStat;
+    }
+
+    //narrowed view; an entry outside the address space is kept out of
+    //reach of any real address
+    memset(&(img -> hdr), 0, sizeof(elf_hdr_t));
+    img -> hdr.e_version = hdr2 -> e_version;
+    img -> hdr.e_entry = hdr2 -> e_entry < MEMSIZE ? hdr2 -> e_entry : UINT16_MAX;
+    img -> hdr.e_num_phdr = hdr2 -> e_num_phdr;
+    img -> hdr.magic = hdr2 -> magic;
+
+    img -> phdrs = (elf_phdr_t*)calloc(hdr2 -> e_num_phdr ? hdr2 -> e_num_phdr : 1, sizeof(elf_phdr_t));
+    if(img -> phdrs == NULL) {
+        return IMG_IOERR;
+    }
+    for(uint32_t i = 0; i < hdr2 -> e_num_phdr; i++) {
+        img -> phdrs[i].p_offset = img -> phdrs2[i].p_offset <= UINT32_MAX ?
+                                   img -> phdrs2[i].p_offset : UINT32_MAX;
+        img -> phdrs[i].p_size = img -> phdrs2[i].p_size;
+        img -> phdrs[i].p_vaddr = img -> phdrs2[i].p_vaddr;
+        img -> phdrs[i].p_type = img -> phdrs2[i].p_type;
+        img -> phdrs[i].p_flags = img -> phdrs2[i].p_flags;
+        img -> phdrs[i].magic = img -> phdrs2[i].magic;
+    }
+    return IMG_OK;
+}
+
+image_stat_t image_parse (elf_image_t *img)
+{
+    if(img == NULL || img -> data == NULL) {
+        return IMG_IOERR;
+    }
+
+    //header checks, same as read_header
+    if(img -> size < sizeof(elf_hdr_t)) {
+        return IMG_BADHDR;
+    }
+    memcpy(&(img -> hdr), img -> data, sizeof(elf_hdr_t));
+
+    if(img -> hdr.e_version == 2) {
+        return image_parse2(img);
+    }
+
+    if(img -> hdr.e_version != 1 || img -> hdr.magic != 0x464C45) {
+        return IMG_BADHDR;
+    }
+
+    //the program header table has to be fully present
+    size_t start = img -> hdr.e_phdr_start;
+    size_t end = start + (size_t)img -> hdr.e_num_phdr * sizeof(elf_phdr_t);
+    if(end > img -> size) {
+        return IMG_BADPHDR;
+    }
+    img -> phdrs = (elf_phdr_t*)(img -> data + start);
+
+    //program header checks (read_phdr) and segment checks (load_segment)
+    //share one walk; a bad header anywhere wins over a bad segment so the
+    //result matches reading every header before loading any segment
+    image_stat_t segStat = IMG_OK;
+    for(int i = 0; i < img -> hdr.e_num_phdr; i++) {
+        elf_phdr_t *phdr = &(img -> phdrs[i]);
+
+        if(phdr -> p_vaddr > MEMSIZE || phdr -> magic != 0xDEADBEEF) {
+            return IMG_BADPHDR;
+        }
+        if(!image_check_segment(img, phdr -> p_offset, phdr -> p_size, phdr -> p_vaddr, phdr -> p_type)) {
+            segStat = IMG_BADSEG;
+        }
+    }
+
+    //widened copy of the header
+    memset(&(img -> hdr2), 0, sizeof(elf_hdr2_t));
+    img -> hdr2.e_version = img -> hdr.e_version;
+    img -> hdr2.e_hdrsize = sizeof(elf_hdr_t);
+    img -> hdr2.e_num_phdr = img -> hdr.e_num_phdr;
+    img -> hdr2.e_entry = img -> hdr.e_entry;
+    img -> hdr2.e_phdr_start = img -> hdr.e_phdr_start;
+    img -> hdr2.e_symtab = img -> hdr.e_symtab;
+    img -> hdr2.e_strtab = img -> hdr.e_strtab;
+    img -> hdr2.e_phentsize = sizeof(elf_phdr_t);
+    img -> hdr2.magic = img -> hdr.magic;
+    return segStat;
+}
+
+const byte_t *image_segment (elf_image_t *img, int i)
+{
+    if(img -> phdrs2 != NULL) {
+        return img -> data + img -> phdrs2[i].p_offset;
+    }
+    return img -> data + img -> phdrs[i].p_offset;
+}
+
+void image_load (elf_image_t *img, byte_t *memory)
+{
+    if(img == NULL || memory == NULL) {
+        return;
+    }
+
+    //guest memory is a single host page, so segments are always copied
+    for(int i = 0; i < img -> hdr.e_num_phdr; i++) {
+        elf_phdr_t *phdr = &(img -> phdrs[i]);
+        if(phdr -> p_size != 0) {
+            memcpy(&memory[phdr -> p_vaddr], image_segment(img, i), phdr -> p_size);
+        }
+    }
+}
+
+void image_close (elf_image_t *img)
+{
+    if(img == NULL || img -> data == NULL) {
+        return;
+    }
+
+    if(img -> mapped) {
+        munmap(img -> data, img -> size);
+    } else if(!img -> borrowed) {
+        free(img -> data);
+    }
+
+    //version 2 images own their narrowed program headers
+    if(img -> phdrs2 != NULL) {
+        free(img -> phdrs);
+    }
+    memset(img, 0, sizeof(elf_image_t));
+}
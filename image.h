@@ -0,0 +1,101 @@
+#ifndef __CS261_IMAGE__
+#define __CS261_IMAGE__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "y86.h"
+
+/* possible results of loading a Mini-ELF image */
+typedef enum {
+    IMG_OK = 0, IMG_IOERR, IMG_BADHDR, IMG_BADPHDR, IMG_BADSEG
+} image_stat_t;
+
+/* Mini-ELF file held in host memory
+
+   Both versions are presented through the version 1 structures so the rest
+   of the program can stay unchanged: for version 2 images hdr and phdrs are
+   a narrowed copy whose addresses are exact (they are validated against
+   MEMSIZE) but whose file offsets are not; the loader itself always uses
+   the full-width offsets. */
+typedef struct elf_image {
+
+    byte_t *data;               // file contents
+    size_t size;                // number of bytes in data
+    bool mapped;                // data is a read-only file mapping
+    bool borrowed;              // data belongs to the caller
+
+    elf_hdr_t hdr;              // validated file header (version 1 layout)
+    elf_phdr_t *phdrs;          // validated program headers (version 1 layout)
+
+    elf_hdr2_t hdr2;            // full-width header (version 1 is widened)
+    elf_phdr2_t *phdrs2;        // version 2 program headers inside data,
+                                // or NULL for version 1 images
+
+} elf_image_t;
+
+/**
+ * @brief Bring a Mini-ELF file into memory without validating it
+ *
+ * Regular files are mapped. Files that cannot be mapped (pipes, FIFOs,
+ * character devices) are read forward into a buffer instead; "-" reads
+ * standard input. image_parse validates the result.
+ *
+ * @param filename Path of the file to open ("-" reads standard input)
+ * @param img Pointer to the image structure to be populated (hdr and phdrs
+ * are left unset)
+ * @returns IMG_OK if the file contents are available, an error code otherwise
+ */
+image_stat_t image_map (const char *filename, elf_image_t *img);
+
+/**
+ * @brief Validate a Mini-ELF image held in a caller's buffer
+ *
+ * Nothing is copied: the buffer must outlive the image, and image_close
+ * leaves it alone. Nothing touches stdio, so this is the loader's entry
+ * point for fuzzing.
+ *
+ * @param data Bytes of the image
+ * @param size Number of bytes
+ * @param img Pointer to the image structure to be populated
+ * @returns IMG_OK if the buffer holds a valid Mini-ELF, an error code otherwise
+ */
+image_stat_t image_borrow (const byte_t *data, size_t size, elf_image_t *img);
+
+/**
+ * @brief Validate the header, program headers and segment bounds of an image
+ * in a single pass over its bytes
+ *
+ * @param img Image with data and size set
+ * @returns IMG_OK if the image is valid, an error code otherwise
+ */
+image_stat_t image_parse (elf_image_t *img);
+
+/**
+ * @brief Find the file bytes of a segment of a validated image
+ *
+ * @param img Validated image
+ * @param i Index of the program header
+ * @returns Pointer to the first byte of the segment inside the image
+ */
+const byte_t *image_segment (elf_image_t *img, int i);
+
+/**
+ * @brief Copy all segments of a validated image into a Y86 address space
+ *
+ * @param img Validated image
+ * @param memory Pointer to the beginning of the Y86 address space
+ */
+void image_load (elf_image_t *img, byte_t *memory);
+
+/**
+ * @brief Release the host memory held by an image
+ *
+ * @param img Image to release
+ */
+void image_close (elf_image_t *img);
+
+#endif
@@ -0,0 +1,590 @@
+/*
+ * Input and output of the I/O traps
+ *
+ * Name: Griffin Moran
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "io.h"
+
+static y86_io_t io_stdio;
+
+y86_io_t *io_current = &io_stdio;
+
+void io_init (y86_io_t *io)
+{
+    if(io == NULL) {
+        return;
+    }
+    memset(io, 0, sizeof(y86_io_t));
+}
+
+void io_init_buffer (y86_io_t *io, const byte_t *input, size_t len)
+{
+    if(io == NULL) {
+        return;
+    }
+    memset(io, 0, sizeof(y86_io_t));
+    io -> buffered = true;
+    io -> input = input;
+    io -> inputLen = input != NULL ? len : 0;
+}
+
+/*
+Instruction count of the read being made.
+*/
+static inline uint64_t io_stamp (y86_io_t *io)
+{
+    return io -> clock != NULL ? *(io -> clock) : io -> records;
+}
+
+static void io_put_uleb (FILE *file, uint64_t v)
+{
+    do {
+        int b = v & 0x7f;
+        v >>= 7;
+        fputc(v != 0 ? b | 0x80 : b, file);
+    } while(v != 0);
+}
+
+static bool io_get_uleb (FILE *file, uint64_t *v)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    int b;
+    do {
+        b = fgetc(file);
+        if(b == EOF || shift > 63) {
+            return false;
+        }
+        value |= (uint64_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while(b & 0x80);
+    *v = value;
+    return true;
+}
+
+/*
+Append the record of one read to the log.
+*/
+static void io_log_put (y86_io_t *io, int tag, int64_t value)
+{
+    uint64_t now = io_stamp(io);
+    fputc(tag, io -> log);
+    io_put_uleb(io -> log, now - io -> logCount);
+    io -> logCount = now;
+    if(tag & IO_LOG_OK) {
+        if(tag & IO_LOG_DEC) {
+            io_put_uleb(io -> log, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+        } else {
+            fputc((byte_t)value, io -> log);
+        }
+    }
+    io -> records++;
+
+    //a run that is killed still leaves every read it made in the log
+    fflush(io -> log);
+}
+
+/*
+Take the next record off the log; false if the run no longer matches it,
+i.e. the read happens at another instruction, is of another kind, or the
+log has ended.
+*/
+static bool io_log_get (y86_io_t *io, int kind, int64_t *value, bool *ok)
+{
+    if(io -> mismatch) {
+        return false;
+    }
+
+    uint64_t now = io_stamp(io);
+    uint64_t delta = 0;
+    uint64_t raw = 0;
+    if(io -> tape) {
+        //reads may follow writes only after a seek
+        fseek(io -> log, 0, SEEK_CUR);
+    }
+    int tag = fgetc(io -> log);
+    if(tag == EOF && io -> tape) {
+        //the rest comes from stdin and is appended
+        clearerr(io -> log);
+        fseek(io -> log, 0, SEEK_END);
+        return false;
+    }
+    bool same = tag != EOF && (tag & IO_LOG_DEC) == kind && io_get_uleb(io -> log, &delta) &&
+                io -> logCount + delta == now;
+    if(same && (tag & IO_LOG_OK)) {
+        if(kind == IO_LOG_DEC) {
+            same = io_get_uleb(io -> log, &raw);
+            *value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+        } else {
+            int c = fgetc(io -> log);
+            same = c != EOF;
+            *value = c;
+        }
+    }
+    if(!same) {
+        io -> mismatch = true;
+        io -> mismatchAt = now;
+        return false;
+    }
+
+    io -> logCount = now;
+    io -> records++;
+    *ok = (tag & IO_LOG_OK) != 0;
+    return true;
+}
+
+/*
+Open a log and check or write its header.
+*/
+static bool io_log_open (y86_io_t *io, const char *path, bool replay)
+{
+    if(io == NULL || path == NULL) {
+        return false;
+    }
+    FILE *file = fopen(path, replay ? "rb" : "wb");
+    if(file == NULL) {
+        return false;
+    }
+
+    uint32_t hdr[2] = { IO_LOG_MAGIC, IO_LOG_VERSION };
+    uint32_t got[2];
+    if(replay ? fread(got, sizeof(got), 1, file) != 1 || memcmp(got, hdr, sizeof(hdr)) != 0 :
+            fwrite(hdr, sizeof(hdr), 1, file) != 1) {
+        fclose(file);
+        return false;
+    }
+
+    if(!replay) {
+        fflush(file);
+    }
+    io -> log = file;
+    io -> replay = replay;
+    io -> logCount = 0;
+    io -> records = 0;
+    io -> mismatch = false;
+    return true;
+}
+
+bool io_record (y86_io_t *io, const char *path)
+{
+    return io_log_open(io, path, false);
+}
+
+bool io_tape (y86_io_t *io)
+{
+    if(io == NULL) {
+        return false;
+    }
+    FILE *file = tmpfile();
+    if(file == NULL) {
+        return false;
+    }
+    io -> log = file;
+    io -> replay = true;
+    io -> tape = true;
+    io -> logCount = 0;
+    io -> records = 0;
+    io -> mismatch = false;
+    return true;
+}
+
+void io_mark (y86_io_t *io, io_mark_t *mark)
+{
+    if(io == NULL || mark == NULL) {
+        return;
+    }
+    mark -> pos = io -> log != NULL ? ftell(io -> log) : 0;
+    mark -> logCount = io -> logCount;
+    mark -> records = io -> records;
+    mark -> written = io -> written;
+    mark -> inputPos = io -> inputPos;
+    mark -> bufLen = io -> bufLen;
+    memcpy(mark -> output, io -> output, sizeof(mark -> output));
+}
+
+void io_rewind (y86_io_t *io, io_mark_t *mark)
+{
+    if(io == NULL || mark == NULL) {
+        return;
+    }
+    if(io -> log != NULL) {
+        fseek(io -> log, mark -> pos, SEEK_SET);
+    }
+    io -> logCount = mark -> logCount;
+    io -> records = mark -> records;
+    io -> written = mark -> written;
+    io -> inputPos = mark -> inputPos;
+    io -> bufLen = mark -> bufLen;
+    memcpy(io -> output, mark -> output, sizeof(io -> output));
+    io -> mismatch = false;
+}
+
+bool io_replay (y86_io_t *io, const char *path)
+{
+    return io_log_open(io, path, true);
+}
+
+void io_replay_skip (y86_io_t *io, uint64_t count)
+{
+    if(io == NULL || io -> log == NULL || !io -> replay) {
+        return;
+    }
+
+    //records are skipped whole; the first one at or after count is kept
+    while(true) {
+        long pos = ftell(io -> log);
+        uint64_t delta = 0;
+        uint64_t raw = 0;
+        int tag = fgetc(io -> log);
+        if(tag == EOF || !io_get_uleb(io -> log, &delta) || io -> logCount + delta >= count) {
+            fseek(io -> log, pos, SEEK_SET);
+            return;
+        }
+        if(tag & IO_LOG_OK) {
+            if(tag & IO_LOG_DEC) {
+                io_get_uleb(io -> log, &raw);
+            } else {
+                fgetc(io -> log);
+            }
+        }
+        io -> logCount += delta;
+        io -> records++;
+    }
+}
+
+bool io_close (y86_io_t *io)
+{
+    if(io == NULL || io -> log == NULL) {
+        return true;
+    }
+    bool ok = io -> replay || !ferror(io -> log);
+    ok = (fclose(io -> log) == 0) && ok;
+    io -> log = NULL;
+    return ok;
+}
+
+int io_listen (const char *where, int backlog, char *path, size_t pathLen)
+{
+    if(where == NULL || *where == '\0' || path == NULL || pathLen == 0) {
+        return -1;
+    }
+    path[0] = '\0';
+
+    int s = -1;
+    if(strspn(where, "0123456789") == strlen(where)) {
+        //a port on the loopback interface only
+        unsigned long port = strtoul(where, NULL, 10);
+        if(port == 0 || port > 65535) {
+            return -1;
+        }
+        struct sockaddr_in sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons((uint16_t)port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int one = 1;
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        if(s < 0 || setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+                bind(s, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+            if(s >= 0) {
+                close(s);
+            }
+            return -1;
+        }
+    } else {
+        struct sockaddr_un sa;
+        if(strlen(where) >= sizeof(sa.sun_path) || strlen(where) >= pathLen) {
+            return -1;
+        }
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        strcpy(sa.sun_path, where);
+
+        //a socket left behind by an earlier run is replaced, nothing else
+        struct stat st;
+        if(stat(where, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(where);
+        }
+        s = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(s < 0 || bind(s, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+            if(s >= 0) {
+                close(s);
+            }
+            return -1;
+        }
+        strcpy(path, where);
+    }
+
+    if(listen(s, backlog) != 0) {
+        close(s);
+        if(path[0] != '\0') {
+            unlink(path);
+            path[0] = '\0';
+        }
+        return -1;
+    }
+    return s;
+}
+
+/*
+Under a deadline, check the clock and, with input set, wait until standard
+input has something for scanf; false, with the read blocked, once the
+deadline has passed.
+*/
+static bool io_wait (y86_io_t *io, bool input)
+{
+    io -> blocked = false;
+    io -> timedOut = false;
+    if(io -> deadline == 0) {
+        return true;
+    }
+
+    int fd = fileno(stdin);
+    int flags = fcntl(fd, F_GETFL);
+    while(true) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        if(now >= io -> deadline) {
+            io -> blocked = true;
+            io -> timedOut = true;
+            return false;
+        }
+        if(!input || flags < 0) {
+            return true;
+        }
+
+        //bytes stdio already holds do not show on the descriptor, so peek
+        //without blocking; end of input is left for scanf to report
+        if(fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+            return true;
+        }
+        int c = getc(stdin);
+        int err = errno;
+        fcntl(fd, F_SETFL, flags);
+        if(c != EOF) {
+            ungetc(c, stdin);
+            return true;
+        }
+        if(!ferror(stdin) || (err != EAGAIN && err != EWOULDBLOCK)) {
+            return true;
+        }
+        clearerr(stdin);
+
+        uint64_t left = (io -> deadline - now + 999999) / 1000000;
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        poll(&pfd, 1, left > INT_MAX ? INT_MAX : (int)left);
+    }
+}
+
+bool io_read_char (y86_io_t *io, char *c)
+{
+    if(!io -> buffered) {
+        if(!io_wait(io, false)) {
+            return false;
+        }
+        if(io -> replay) {
+            int64_t value = 0;
+            bool ok = false;
+            if(io_log_get(io, 0, &value, &ok)) {
+                *c = (char)value;
+                return ok;
+            }
+            if(!io -> tape || io -> mismatch) {
+                return false;
+            }
+        }
+        if(!io_wait(io, true)) {
+            return false;
+        }
+        bool ok = scanf("%c", c) == 1;
+        if(io -> log != NULL) {
+            io_log_put(io, ok ? IO_LOG_OK : 0, ok ? (byte_t)*c : 0);
+        }
+        return ok;
+    }
+    io -> blocked = false;
+    if(io -> inputPos >= io -> inputLen) {
+        io -> blocked = io -> more;
+        return false;
+    }
+    *c = (char)io -> input[io -> inputPos++];
+    return true;
+}
+
+/*
+Accumulate one digit of a magnitude, saturating like strtoll.
+*/
+static inline void io_dec_digit (uint64_t *mag, bool *over, int c)
+{
+    uint64_t d = c - '0';
+    if(*mag > (UINT64_MAX - d) / 10) {
+        *over = true;
+    } else {
+        *mag = *mag * 10 + d;
+    }
+}
+
+static int64_t io_dec_value (bool neg, uint64_t mag, bool over)
+{
+    if(neg) {
+        return (over || mag > (uint64_t)INT64_MAX + 1) ? INT64_MIN :
+               mag == 0 ? 0 : -(int64_t)(mag - 1) - 1;
+    }
+    return (over || mag > (uint64_t)INT64_MAX) ? INT64_MAX : (int64_t)mag;
+}
+
+/*
+scanf("%lld") on standard input under a deadline, which scanf could wait
+past for white space or digits still to come: every character is waited for
+with io_wait. False if the deadline passed first; what was taken by then is
+lost, since the run ends there.
+*/
+static bool io_scan_dec (y86_io_t *io, int64_t *v, bool *ok)
+{
+    int c;
+    *ok = false;
+    do {
+        if(!io_wait(io, true)) {
+            return false;
+        }
+        c = getchar();
+    } while(c != EOF && isspace(c));
+
+    bool neg = false;
+    if(c == '+' || c == '-') {
+        neg = c == '-';
+        if(!io_wait(io, true)) {
+            return false;
+        }
+        c = getchar();
+    }
+
+    uint64_t mag = 0;
+    bool over = false;
+    bool digits = false;
+    while(c != EOF && isdigit(c)) {
+        io_dec_digit(&mag, &over, c);
+        digits = true;
+        if(!io_wait(io, true)) {
+            return false;
+        }
+        c = getchar();
+    }
+    if(c != EOF) {
+        ungetc(c, stdin);
+    }
+
+    if(digits) {
+        *v = io_dec_value(neg, mag, over);
+        *ok = true;
+    }
+    return true;
+}
+
+bool io_read_dec (y86_io_t *io, int64_t *v)
+{
+    if(!io -> buffered) {
+        if(!io_wait(io, false)) {
+            return false;
+        }
+        if(io -> replay) {
+            bool ok = false;
+            if(io_log_get(io, IO_LOG_DEC, v, &ok)) {
+                return ok;
+            }
+            if(!io -> tape || io -> mismatch) {
+                return false;
+            }
+        }
+        int64_t n = 0;
+        bool ok = false;
+        if(io -> deadline != 0) {
+            if(!io_scan_dec(io, &n, &ok)) {
+                return false;
+            }
+        } else {
+            long long scanned = 0;
+            ok = scanf("%lld", &scanned) == 1;
+            n = scanned;
+        }
+        if(io -> log != NULL) {
+            io_log_put(io, ok ? IO_LOG_DEC | IO_LOG_OK : IO_LOG_DEC, ok ? n : 0);
+        }
+        if(ok) {
+            *v = n;
+        }
+        return ok;
+    }
+
+    const byte_t *in = io -> input;
+    size_t len = io -> inputLen;
+    size_t p = io -> inputPos;
+    io -> blocked = false;
+    while(p < len && isspace(in[p])) {
+        p++;
+    }
+
+    //white space is taken either way, the number only once it has ended
+    size_t start = p;
+    bool neg = false;
+    if(p < len && (in[p] == '+' || in[p] == '-')) {
+        neg = in[p] == '-';
+        p++;
+    }
+    if(p >= len && io -> more) {
+        io -> inputPos = start;
+        io -> blocked = true;
+        return false;
+    }
+    if(p >= len || !isdigit(in[p])) {
+        io -> inputPos = p;
+        return false;
+    }
+
+    uint64_t mag = 0;
+    bool over = false;
+    while(p < len && isdigit(in[p])) {
+        io_dec_digit(&mag, &over, in[p++]);
+    }
+    if(p >= len && io -> more) {
+        io -> inputPos = start;
+        io -> blocked = true;
+        return false;
+    }
+    io -> inputPos = p;
+    *v = io_dec_value(neg, mag, over);
+    return true;
+}
+
+void io_write (y86_io_t *io, const char *s)
+{
+    if(io -> clock != NULL && *(io -> clock) < io -> quietUntil) {
+        return;
+    }
+    if(io -> sink != NULL) {
+        io -> sink(io -> sinkArg, s);
+        return;
+    }
+    if(io -> buffered) {
+        io -> written += strlen(s);
+        return;
+    }
+    printf("%s", s);
+}
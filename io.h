@@ -0,0 +1,228 @@
+#ifndef __CS261_IO__
+#define __CS261_IO__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+
+/* characters the I/O traps buffer before FLUSH prints them */
+#define IO_BUFSIZE 101
+
+#define IO_LOG_MAGIC 0x52363859     /* "Y86R" */
+#define IO_LOG_VERSION 1
+
+/*
+   Input log format: an 8-byte header (IO_LOG_MAGIC, IO_LOG_VERSION as
+   32-bit words) followed by one record per input trap:
+   +------+--------------------------+------------------------------+
+   | tag  | count delta (ULEB128)    | value                        |
+   +------+--------------------------+------------------------------+
+   The tag is IO_LOG_DEC for DECIN (CHARIN otherwise) plus IO_LOG_OK if
+   the read succeeded. The delta is the number of instructions retired
+   since the previous record. Only successful reads have a value: the
+   character byte, or the number zigzag-encoded as ULEB128.
+*/
+#define IO_LOG_DEC 0x01
+#define IO_LOG_OK  0x02
+
+/* takes the output of the traps instead of standard output */
+typedef void (*io_sink_t) (void *arg, const char *s);
+
+/* where the I/O traps take their input and send their output
+
+   A zeroed structure uses standard input and output. In memory, input is
+   taken from a byte buffer and output is counted but not kept (or handed
+   to a sink), so running a program touches no stdio at all. A buffer that
+   may still grow makes the input traps non-blocking: a read that runs out
+   of it takes nothing and leaves the trap to be run again once more input
+   has arrived. */
+typedef struct y86_io {
+
+    bool buffered;              // input and output stay in memory
+
+    const byte_t *input;        // input bytes (buffered)
+    size_t inputLen;            // number of input bytes
+    size_t inputPos;            // next input byte
+
+    bool more;                  // input may still grow (buffered): a read
+                                // that runs out of it blocks instead
+    bool blocked;               // the last read blocked (see more)
+    uint64_t deadline;          // monotonic time in ns unbuffered reads
+                                // give up at (0 for none)
+    bool timedOut;              // the last read blocked on the deadline
+
+    uint64_t written;           // output bytes dropped (buffered)
+    io_sink_t sink;             // takes the output instead, or NULL
+    void *sinkArg;              // argument passed to sink
+
+    char output[IO_BUFSIZE + 1];    // output of the traps until FLUSH
+    size_t bufLen;              // characters put into output so far
+
+    FILE *log;                  // input log being recorded or replayed
+    bool replay;                //   input comes from the log, not stdin
+    const uint64_t *clock;      // instruction count stamped on log records
+    uint64_t logCount;          // count of the previous record
+    uint64_t records;           // records written or read
+    bool mismatch;              // replay no longer matches the log
+    uint64_t mismatchAt;        //   at this instruction count
+    bool tape;                  // the replayed log goes on with stdin (and
+                                // records it) once it ends
+
+    uint64_t quietUntil;        // output of instructions before this count
+                                // is dropped (history being run again)
+
+} y86_io_t;
+
+/* position of a run in its I/O, to go back to */
+typedef struct io_mark {
+    long pos;                   // offset in the log
+    uint64_t logCount;          // count of the previous record
+    uint64_t records;           // records read or written
+    uint64_t written;           // buffered output dropped
+    size_t inputPos;            // buffered input consumed
+    size_t bufLen;              // trap buffer
+    char output[IO_BUFSIZE + 1];
+} io_mark_t;
+
+/* I/O of the running program; never NULL (standard I/O by default) */
+extern y86_io_t *io_current;
+
+/**
+ * @brief Set up I/O on standard input and output
+ *
+ * @param io Pointer to the I/O state
+ */
+void io_init (y86_io_t *io);
+
+/**
+ * @brief Set up I/O in memory
+ *
+ * @param io Pointer to the I/O state
+ * @param input Bytes the input traps read (not copied)
+ * @param len Number of input bytes
+ */
+void io_init_buffer (y86_io_t *io, const byte_t *input, size_t len);
+
+/**
+ * @brief Log every value the input traps read from standard input
+ *
+ * @param io Pointer to the I/O state (standard I/O)
+ * @param path Log file to create
+ * @returns True if the log could be created, false otherwise
+ */
+bool io_record (y86_io_t *io, const char *path);
+
+/**
+ * @brief Take the input traps' values from a log instead of standard input
+ *
+ * Every read must happen at the instruction count and be of the kind the
+ * log says; otherwise the run has diverged from the recorded one, which is
+ * noted in mismatch, and this and every later read fail.
+ *
+ * @param io Pointer to the I/O state (standard I/O)
+ * @param path Log file written by io_record
+ * @returns True if the log could be opened, false otherwise
+ */
+bool io_replay (y86_io_t *io, const char *path);
+
+/**
+ * @brief Log the input traps' reads in a temporary file that can be rewound
+ *
+ * Reads come from standard input and are recorded. After io_rewind, the
+ * reads are replayed from the log until it ends, and from there on come
+ * from standard input again, so a run can go back in time and through the
+ * same reads any number of times.
+ *
+ * @param io Pointer to the I/O state (standard I/O)
+ * @returns True if the temporary file could be created, false otherwise
+ */
+bool io_tape (y86_io_t *io);
+
+/**
+ * @brief Save the position of a run in its I/O
+ *
+ * @param io Pointer to the I/O state
+ * @param mark Pointer to the position to be populated
+ */
+void io_mark (y86_io_t *io, io_mark_t *mark);
+
+/**
+ * @brief Go back to a position saved by io_mark
+ *
+ * @param io Pointer to the I/O state (replaying or a tape, see io_tape)
+ * @param mark Position to go back to
+ */
+void io_rewind (y86_io_t *io, io_mark_t *mark);
+
+/**
+ * @brief Skip the replayed records of reads before an instruction count
+ *
+ * @param io Pointer to the I/O state
+ * @param count Instruction count a restored run continues from
+ */
+void io_replay_skip (y86_io_t *io, uint64_t count);
+
+/**
+ * @brief Finish the input log, if any
+ *
+ * @param io Pointer to the I/O state
+ * @returns False if a recorded log could not be written completely
+ */
+bool io_close (y86_io_t *io);
+
+/**
+ * @brief Listen for connections on a local socket
+ *
+ * A name made only of digits is a TCP port on the loopback interface;
+ * anything else is the path of a Unix socket, which replaces a socket left
+ * there by an earlier run but nothing else.
+ *
+ * @param where Port number or socket path
+ * @param backlog Connections the kernel queues before they are accepted
+ * @param path Set to the socket file to remove when done ("" for a port)
+ * @param pathLen Size of path
+ * @returns Listening socket, or -1 on failure
+ */
+int io_listen (const char *where, int backlog, char *path, size_t pathLen);
+
+/**
+ * @brief Read one character, like scanf("%c")
+ *
+ * Under a deadline, a read from standard input waits for it only as long
+ * as the deadline allows, and a read made after the deadline takes
+ * nothing; either way it blocks with io -> timedOut set.
+ *
+ * @param io Pointer to the I/O state
+ * @param c Pointer to the character read
+ * @returns True if a character was read, false at end of input or, with
+ * io -> blocked set, when more input has to arrive first
+ */
+bool io_read_char (y86_io_t *io, char *c);
+
+/**
+ * @brief Read a signed decimal number, like scanf("%lld")
+ *
+ * Leading white space is skipped; values out of range saturate. A number
+ * that reaches the end of input that may still grow is not taken, since
+ * more digits could follow. Deadlines apply as in io_read_char.
+ *
+ * @param io Pointer to the I/O state
+ * @param v Pointer to the number read
+ * @returns True if a number was read, false otherwise (with io -> blocked
+ * set when more input has to arrive first)
+ */
+bool io_read_dec (y86_io_t *io, int64_t *v);
+
+/**
+ * @brief Write a string, like printf("%s"), or hand it to the sink
+ *
+ * @param io Pointer to the I/O state
+ * @param s String to write
+ */
+void io_write (y86_io_t *io, const char *s);
+
+#endif
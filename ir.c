@@ -0,0 +1,791 @@
+/*
+ * Intermediate representation of decoded blocks and its optimization passes
+ *
+ * Name: Griffin Moran
+ */
+
+#include "ir.h"
+#include "p4-interp.h"
+#include "predecode.h"
+#include "mem.h"
+#include "io.h"
+
+/* values forwarded from memory: M[r[base] + off] == r[src] */
+#define IR_FORWARDS 8
+
+typedef struct ir_fwd {
+    uint8_t base;
+    uint8_t src;
+    int64_t off;
+} ir_fwd_t;
+
+/*
+ALU operation exactly as decode_execute computes it, including its overflow
+test for subq. The resulting condition codes are returned as IR_* bits.
+*/
+static inline y86_reg_t ir_alu (uint8_t fn, y86_reg_t valA, y86_reg_t valB, uint8_t *cc)
+{
+    y86_reg_t valE;
+    bool of = false;
+
+    switch(fn) {
+        case (ADD):
+            valE = valB + valA;
+            of = (((int64_t)valA < 0) == ((int64_t)valB < 0)) &&
+                 (((int64_t)valE < 0) != ((int64_t)valB < 0));
+            break;
+
+        case (SUB):
+            valE = valB - valA;
+            of = ((int64_t)valA > 0 && (int64_t)valE > (int64_t)valB) ||
+                 ((int64_t)valA < 0 && (int64_t)valE < (int64_t)valB);
+            break;
+
+        case (AND):
+            valE = valB & valA;
+            break;
+
+        default:
+            valE = valB ^ valA;
+            break;
+    }
+
+    *cc = ((int64_t)valE == 0 ? IR_ZF : 0) | ((int64_t)valE < 0 ? IR_SF : 0) | (of ? IR_OF : 0);
+    return valE;
+}
+
+/*
+Condition of a conditional move or jump.
+*/
+static inline bool ir_cond (y86_t *cpu, uint8_t fn)
+{
+    switch(fn) {
+        case (JLE):
+            return (cpu -> sf ^ cpu -> of) || cpu -> zf;
+        case (JL):
+            return cpu -> sf ^ cpu -> of;
+        case (JE):
+            return cpu -> zf;
+        case (JNE):
+            return !cpu -> zf;
+        case (JGE):
+            return !(cpu -> sf ^ cpu -> of);
+        case (JG):
+            return !(cpu -> sf ^ cpu -> of) && !cpu -> zf;
+        default:
+            return true;
+    }
+}
+
+/*
+Whether an operation ends its block.
+*/
+static inline bool ir_ends (ir_op_t *op)
+{
+    switch(op -> kind) {
+        case (IR_JMP):
+        case (IR_BR):
+        case (IR_CALL):
+        case (IR_RET):
+        case (IR_STOP):
+            return true;
+
+        case (IR_EXEC):
+            return (op -> op >> 4) == HALT;
+
+        default:
+            return false;
+    }
+}
+
+/*
+Lower one decoded instruction.
+*/
+static ir_op_t ir_lower (y86_packed_t *packed, address_t pc)
+{
+    ir_op_t op;
+    memset(&op, 0, sizeof(ir_op_t));
+    op.op = packed -> op;
+    op.regs = packed -> regs;
+    op.len = packed -> len;
+    op.pc = pc;
+    op.imm = packed -> valC;
+
+    uint8_t icode = packed -> op >> 4;
+    uint8_t ifun = packed -> op & 0x0F;
+    uint8_t ra = packed -> regs >> 4;
+    uint8_t rb = packed -> regs & 0x0F;
+    op.a = NOREG;
+    op.d = NOREG;
+
+    if(packed -> stat != 0) {
+        op.kind = IR_STOP;
+        op.fn = packed -> stat;
+        return op;
+    }
+
+    switch(icode) {
+        case (NOP):
+            op.kind = IR_NOP;
+            break;
+
+        case (CMOV):
+            op.kind = ifun == RRMOVQ ? IR_MOV : IR_CMOV;
+            op.fn = ifun;
+            op.d = rb;
+            op.a = ra;
+            break;
+
+        case (IRMOVQ):
+            op.kind = IR_MOVI;
+            op.d = rb;
+            break;
+
+        //NOREG reads and writes the flags as the interpreter lays them out
+        case (RMMOVQ):
+            op.kind = rb == NOREG ? IR_EXEC : IR_STORE;
+            op.d = ra;
+            op.a = rb;
+            break;
+
+        case (MRMOVQ):
+            op.kind = (ra == NOREG || rb == NOREG) ? IR_EXEC : IR_LOAD;
+            op.d = ra;
+            op.a = rb;
+            break;
+
+        case (OPQ):
+            op.kind = IR_OP;
+            op.fn = ifun;
+            op.d = rb;
+            op.a = ra;
+            break;
+
+        case (JUMP):
+            op.kind = ifun == JMP ? IR_JMP : IR_BR;
+            op.fn = ifun;
+            break;
+
+        case (CALL):
+            op.kind = IR_CALL;
+            break;
+
+        case (RET):
+            op.kind = IR_RET;
+            break;
+
+        case (PUSHQ):
+            op.kind = IR_PUSH;
+            op.a = ra;
+            break;
+
+        case (POPQ):
+            op.kind = IR_POP;
+            op.d = ra;
+            break;
+
+        default:
+            op.kind = IR_EXEC;
+            break;
+    }
+    return op;
+}
+
+bool ir_build (y86_decoded_t *prog, address_t entry, ir_program_t *ir)
+{
+    if(prog == NULL || prog -> slot == NULL || ir == NULL) {
+        return false;
+    }
+    memset(ir, 0, sizeof(ir_program_t));
+
+    ir -> block = (int32_t*)malloc(MEMSIZE * sizeof(int32_t));
+    bool *leader = (bool*)calloc(MEMSIZE, sizeof(bool));
+    bool *reached = (bool*)calloc(MEMSIZE, sizeof(bool));
+    if(ir -> block == NULL || leader == NULL || reached == NULL) {
+        free(leader);
+        free(reached);
+        ir_free(ir);
+        return false;
+    }
+    for(int i = 0; i < MEMSIZE; i++) {
+        ir -> block[i] = -1;
+    }
+
+    //leaders: the entry point, static targets, whatever follows a transfer
+    //of control, and instructions no decoded instruction falls into
+    if(entry < MEMSIZE) {
+        leader[entry] = true;
+    }
+    uint32_t total = 0;
+    for(address_t pc = 0; pc < MEMSIZE; pc++) {
+        if(prog -> slot[pc] < 0) {
+            continue;
+        }
+        ir_op_t op = ir_lower(&(prog -> insts[prog -> slot[pc]]), pc);
+        address_t next = pc + op.len;
+        total++;
+        if((op.kind == IR_JMP || op.kind == IR_BR || op.kind == IR_CALL) &&
+                (uint64_t)op.imm < MEMSIZE) {
+            leader[op.imm] = true;
+        }
+        if(op.kind != IR_STOP && next < MEMSIZE) {
+            if(ir_ends(&op)) {
+                leader[next] = true;
+            } else {
+                reached[next] = true;
+            }
+        }
+    }
+
+    //an instruction belongs to every block whose chain reaches it, which is
+    //only more than one when decoded segments overlap
+    uint32_t capacity = total;
+    ir -> ops = (ir_op_t*)malloc((capacity ? capacity : 1) * sizeof(ir_op_t));
+    ir -> blocks = (ir_block_t*)malloc((total ? total : 1) * sizeof(ir_block_t));
+    if(ir -> ops == NULL || ir -> blocks == NULL) {
+        free(leader);
+        free(reached);
+        ir_free(ir);
+        return false;
+    }
+
+    for(address_t start = 0; start < MEMSIZE; start++) {
+        if(prog -> slot[start] < 0 || (!leader[start] && reached[start])) {
+            continue;
+        }
+
+        ir_block_t *blk = &(ir -> blocks[ir -> numBlocks]);
+        blk -> start = start;
+        blk -> end = start;
+        blk -> first = ir -> numOps;
+        blk -> count = 0;
+
+        address_t pc = start;
+        while(true) {
+            if(ir -> numOps == capacity) {
+                capacity *= 2;
+                ir_op_t *ops = (ir_op_t*)realloc(ir -> ops, capacity * sizeof(ir_op_t));
+                if(ops == NULL) {
+                    free(leader);
+                    free(reached);
+                    ir_free(ir);
+                    return false;
+                }
+                ir -> ops = ops;
+            }
+
+            ir_op_t *op = &(ir -> ops[ir -> numOps++]);
+            *op = ir_lower(&(prog -> insts[prog -> slot[pc]]), pc);
+            blk -> count++;
+
+            address_t span = op -> kind == IR_STOP ? 10 : op -> len;
+            if(pc + span > blk -> end) {
+                blk -> end = pc + span;
+            }
+
+            pc += op -> len;
+            if(ir_ends(op) || pc >= MEMSIZE || prog -> slot[pc] < 0 || leader[pc]) {
+                break;
+            }
+        }
+        ir -> block[start] = ir -> numBlocks++;
+    }
+
+    free(leader);
+    free(reached);
+    return true;
+}
+
+/*
+Forget forwarded values that depend on a register about to be written.
+*/
+static void ir_fwd_kill (ir_fwd_t *fwd, int *n, uint8_t r)
+{
+    for(int i = 0; i < *n; i++) {
+        if(fwd[i].base == r || fwd[i].src == r) {
+            fwd[i--] = fwd[--(*n)];
+        }
+    }
+}
+
+/*
+Forget forwarded values a store of eight bytes at r[base] + off may overwrite.
+*/
+static void ir_fwd_store (ir_fwd_t *fwd, int *n, uint8_t base, int64_t off)
+{
+    for(int i = 0; i < *n; i++) {
+        if(fwd[i].base != base || (uint64_t)(fwd[i].off - off) + 7 < 15) {
+            fwd[i--] = fwd[--(*n)];
+        }
+    }
+}
+
+static void ir_fwd_add (ir_fwd_t *fwd, int *n, uint8_t base, int64_t off, uint8_t src)
+{
+    if(*n == IR_FORWARDS) {
+        fwd[0] = fwd[--(*n)];
+    }
+    fwd[*n].base = base;
+    fwd[*n].off = off;
+    fwd[*n].src = src;
+    (*n)++;
+}
+
+/*
+Move the stack entries along with %rsp.
+*/
+static void ir_fwd_rebase (ir_fwd_t *fwd, int n, int64_t delta)
+{
+    for(int i = 0; i < n; i++) {
+        if(fwd[i].base == RSP) {
+            fwd[i].off -= delta;
+        }
+    }
+}
+
+/*
+Load/store forwarding: a load of a location whose value is still held in a
+register becomes a move from that register, and a pop of the value just
+pushed from a register keeps only the update of %rsp. The location was
+already accessed successfully, so the load cannot fault.
+*/
+static void ir_forward (ir_program_t *ir, ir_block_t *blk)
+{
+    ir_fwd_t fwd[IR_FORWARDS];
+    int n = 0;
+
+    for(uint32_t k = 0; k < blk -> count; k++) {
+        ir_op_t *op = &(ir -> ops[blk -> first + k]);
+        int i;
+
+        switch(op -> kind) {
+            case (IR_LOAD):
+                for(i = 0; i < n; i++) {
+                    if(fwd[i].base == op -> a && fwd[i].off == op -> imm) {
+                        break;
+                    }
+                }
+                if(i < n) {
+                    op -> kind = IR_MOV;
+                    op -> a = fwd[i].src;
+                    ir -> forwarded++;
+                    ir_fwd_kill(fwd, &n, op -> d);
+                    break;
+                }
+                ir_fwd_kill(fwd, &n, op -> d);
+                if(op -> d != op -> a) {
+                    ir_fwd_add(fwd, &n, op -> a, op -> imm, op -> d);
+                }
+                break;
+
+            case (IR_STORE):
+                ir_fwd_store(fwd, &n, op -> a, op -> imm);
+                ir_fwd_add(fwd, &n, op -> a, op -> imm, op -> d);
+                break;
+
+            case (IR_PUSH):
+                ir_fwd_rebase(fwd, n, -8);
+                ir_fwd_store(fwd, &n, RSP, 0);
+                for(i = 0; i < n; i++) {
+                    if(fwd[i].src == RSP) {
+                        fwd[i--] = fwd[--n];
+                    }
+                }
+                if(op -> a != RSP) {
+                    ir_fwd_add(fwd, &n, RSP, 0, op -> a);
+                }
+                break;
+
+            case (IR_POP):
+                for(i = 0; i < n; i++) {
+                    if(fwd[i].base == RSP && fwd[i].off == 0) {
+                        break;
+                    }
+                }
+                if(i < n) {
+                    op -> kind = IR_POPF;
+                    op -> a = fwd[i].src;
+                    ir -> forwarded++;
+                }
+                ir_fwd_rebase(fwd, n, 8);
+                for(i = 0; i < n; i++) {
+                    if(fwd[i].src == RSP) {
+                        fwd[i--] = fwd[--n];
+                    }
+                }
+                ir_fwd_kill(fwd, &n, op -> d);
+                if(op -> d != RSP) {
+                    ir_fwd_add(fwd, &n, RSP, -8, op -> d);
+                }
+                break;
+
+            case (IR_MOVI):
+            case (IR_MOV):
+            case (IR_CMOV):
+            case (IR_OP):
+                ir_fwd_kill(fwd, &n, op -> d);
+                break;
+
+            case (IR_EXEC):
+                n = 0;
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/*
+Constant propagation within a block.
+*/
+static void ir_fold (ir_program_t *ir, ir_block_t *blk)
+{
+    bool known[NUMREGS];
+    y86_reg_t val[NUMREGS];
+    memset(known, 0, sizeof(known));
+    memset(val, 0, sizeof(val));
+
+    for(uint32_t k = 0; k < blk -> count; k++) {
+        ir_op_t *op = &(ir -> ops[blk -> first + k]);
+        uint8_t cc;
+
+        switch(op -> kind) {
+            case (IR_MOVI):
+                known[op -> d] = true;
+                val[op -> d] = op -> imm;
+                break;
+
+            case (IR_MOV):
+                if(known[op -> a]) {
+                    op -> kind = IR_MOVI;
+                    op -> imm = val[op -> a];
+                    ir -> folded++;
+                }
+                known[op -> d] = known[op -> a];
+                val[op -> d] = val[op -> a];
+                break;
+
+            case (IR_CMOV):
+                known[op -> d] = false;
+                break;
+
+            case (IR_OP):
+                if(op -> a == op -> d && (op -> fn == SUB || op -> fn == XOR)) {
+                    //x - x and x ^ x are zero whatever x is
+                    op -> kind = IR_SET;
+                    op -> imm = ir_alu(op -> fn, 0, 0, &cc);
+                    op -> fn = cc;
+                    ir -> folded++;
+                } else if(known[op -> a] && known[op -> d]) {
+                    op -> kind = IR_SET;
+                    op -> imm = ir_alu(op -> fn, val[op -> a], val[op -> d], &cc);
+                    op -> fn = cc;
+                    ir -> folded++;
+                } else if(known[op -> a]) {
+                    op -> kind = IR_OPI;
+                    op -> imm = val[op -> a];
+                    ir -> folded++;
+                }
+                known[op -> d] = op -> kind == IR_SET;
+                val[op -> d] = op -> imm;
+                break;
+
+            case (IR_LOAD):
+            case (IR_STORE):
+                if(known[op -> a]) {
+                    op -> imm += val[op -> a];
+                    op -> a = NOREG;
+                    ir -> folded++;
+                }
+                if(op -> kind == IR_LOAD) {
+                    known[op -> d] = false;
+                }
+                break;
+
+            case (IR_PUSH):
+                val[RSP] -= 8;
+                break;
+
+            case (IR_POP):
+            case (IR_POPF):
+                val[RSP] += 8;
+                known[op -> d] = false;
+                break;
+
+            case (IR_EXEC):
+                memset(known, 0, sizeof(known));
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+/*
+Dead-flag elimination: the condition codes of an ALU operation are dead when
+another one overwrites them before anything reads them and before any point
+where the block could stop and show them.
+*/
+static void ir_dead_flags (ir_program_t *ir, ir_block_t *blk)
+{
+    bool live = true;
+
+    for(uint32_t k = blk -> count; k-- > 0; ) {
+        ir_op_t *op = &(ir -> ops[blk -> first + k]);
+
+        switch(op -> kind) {
+            case (IR_OP):
+            case (IR_OPI):
+            case (IR_SET):
+                if(!live) {
+                    op -> flags |= IRF_NOFLAGS;
+                    ir -> deadFlags++;
+                }
+                live = false;
+                break;
+
+            case (IR_NOP):
+            case (IR_MOVI):
+            case (IR_MOV):
+            case (IR_POPF):
+                break;
+
+            default:
+                live = true;
+                break;
+        }
+    }
+}
+
+void ir_optimize (ir_program_t *ir)
+{
+    if(ir == NULL) {
+        return;
+    }
+    for(uint32_t b = 0; b < ir -> numBlocks; b++) {
+        ir_forward(ir, &(ir -> blocks[b]));
+        ir_fold(ir, &(ir -> blocks[b]));
+        ir_dead_flags(ir, &(ir -> blocks[b]));
+    }
+}
+
+void ir_invalidate (ir_program_t *ir, address_t addr, address_t len)
+{
+    if(ir == NULL || ir -> block == NULL) {
+        return;
+    }
+    for(uint32_t b = 0; b < ir -> numBlocks; b++) {
+        ir_block_t *blk = &(ir -> blocks[b]);
+        if(addr < blk -> end && addr + len > blk -> start && ir -> block[blk -> start] == (int32_t)b) {
+            ir -> block[blk -> start] = -1;
+            ir -> gen++;
+        }
+    }
+}
+
+/*
+Stop the block after the k-th operation retired.
+*/
+static inline bool ir_exit (y86_t *cpu, uint64_t *count, uint32_t k, address_t pc)
+{
+    cpu -> pc = pc;
+    *count += k;
+    return true;
+}
+
+/*
+Leave the k-th operation to the interpreter; the ones before it retired.
+*/
+static inline bool ir_bail (y86_t *cpu, uint64_t *count, uint32_t k, address_t pc)
+{
+    cpu -> pc = pc;
+    *count += k;
+    return false;
+}
+
+bool ir_run (ir_program_t *ir, ir_block_t *blk, y86_t *cpu, byte_t *memory, uint64_t *count)
+{
+    ir_op_t *ops = &(ir -> ops[blk -> first]);
+    y86_reg_t *reg = cpu -> reg;
+    uint64_t gen = ir -> gen;
+    y86_reg_t addr;
+    y86_reg_t val;
+    uint8_t cc;
+
+    for(uint32_t k = 0; k < blk -> count; k++) {
+        ir_op_t *op = &ops[k];
+        address_t next = op -> pc + op -> len;
+
+        switch(op -> kind) {
+            case (IR_NOP):
+                break;
+
+            case (IR_MOVI):
+                reg[op -> d] = op -> imm;
+                break;
+
+            case (IR_MOV):
+                reg[op -> d] = reg[op -> a];
+                break;
+
+            case (IR_CMOV):
+                if(ir_cond(cpu, op -> fn)) {
+                    reg[op -> d] = reg[op -> a];
+                }
+                break;
+
+            case (IR_OP):
+            case (IR_OPI):
+                val = op -> kind == IR_OP ? reg[op -> a] : (y86_reg_t)op -> imm;
+                reg[op -> d] = ir_alu(op -> fn, val, reg[op -> d], &cc);
+                if(!(op -> flags & IRF_NOFLAGS)) {
+                    cpu -> zf = cc & IR_ZF;
+                    cpu -> sf = cc & IR_SF;
+                    cpu -> of = cc & IR_OF;
+                }
+                break;
+
+            case (IR_SET):
+                reg[op -> d] = op -> imm;
+                if(!(op -> flags & IRF_NOFLAGS)) {
+                    cpu -> zf = op -> fn & IR_ZF;
+                    cpu -> sf = op -> fn & IR_SF;
+                    cpu -> of = op -> fn & IR_OF;
+                }
+                break;
+
+            case (IR_LOAD):
+            case (IR_STORE):
+                addr = (op -> a == NOREG ? 0 : reg[op -> a]) + op -> imm;
+                if(addr > MEMSIZE - 8) {
+                    cpu -> stat = ADR;
+                    return ir_exit(cpu, count, k + 1, next);
+                }
+                mem_touch(addr, 8);
+                if(op -> kind == IR_LOAD) {
+                    memcpy(&reg[op -> d], memory + addr, sizeof(y86_reg_t));
+                    break;
+                }
+                memcpy(memory + addr, &reg[op -> d], sizeof(y86_reg_t));
+                mem_store(addr, 8);
+                if(ir -> gen != gen) {
+                    return ir_exit(cpu, count, k + 1, next);
+                }
+                break;
+
+            case (IR_PUSH):
+                addr = reg[RSP] - 8;
+                if(addr > MEMSIZE - 8) {
+                    return ir_bail(cpu, count, k, op -> pc);
+                }
+                val = reg[op -> a];
+                mem_touch(addr, 8);
+                memcpy(memory + addr, &val, sizeof(y86_reg_t));
+                mem_store(addr, 8);
+                reg[RSP] = addr;
+                if(ir -> gen != gen) {
+                    return ir_exit(cpu, count, k + 1, next);
+                }
+                break;
+
+            case (IR_POP):
+                addr = reg[RSP];
+                if(addr > MEMSIZE - 8) {
+                    return ir_bail(cpu, count, k, op -> pc);
+                }
+                mem_touch(addr, 8);
+                memcpy(&val, memory + addr, sizeof(y86_reg_t));
+                reg[RSP] = addr + 8;
+                reg[op -> d] = val;
+                break;
+
+            case (IR_POPF):
+                val = reg[op -> a];
+                reg[RSP] += 8;
+                reg[op -> d] = val;
+                break;
+
+            case (IR_JMP):
+                return ir_exit(cpu, count, k + 1, op -> imm);
+
+            case (IR_BR):
+                return ir_exit(cpu, count, k + 1, ir_cond(cpu, op -> fn) ? (address_t)op -> imm : next);
+
+            case (IR_CALL):
+                addr = reg[RSP] - 8;
+                if((int64_t)addr < 0) {
+                    cpu -> stat = ADR;
+                    return ir_exit(cpu, count, k + 1, op -> imm);
+                }
+                if(addr > MEMSIZE - 8) {
+                    return ir_bail(cpu, count, k, op -> pc);
+                }
+                mem_touch(addr, 8);
+                memcpy(memory + addr, &next, sizeof(y86_reg_t));
+                mem_store(addr, 8);
+                reg[RSP] = addr;
+                return ir_exit(cpu, count, k + 1, op -> imm);
+
+            case (IR_RET):
+                addr = reg[RSP];
+                if(addr > MEMSIZE - 8) {
+                    return ir_bail(cpu, count, k, op -> pc);
+                }
+                mem_touch(addr, 8);
+                memcpy(&val, memory + addr, sizeof(y86_reg_t));
+                reg[RSP] = addr + 8;
+                return ir_exit(cpu, count, k + 1, val);
+
+            case (IR_EXEC): {
+                y86_packed_t packed;
+                memset(&packed, 0, sizeof(y86_packed_t));
+                packed.op = op -> op;
+                packed.regs = op -> regs;
+                packed.valC = op -> imm;
+                packed.len = op -> len;
+                y86_inst_t inst = unpack_inst(&packed, op -> pc);
+                bool cnd = false;
+                y86_reg_t valA = 0;
+
+                //the count is brought up to date for the I/O log, which
+                //stamps the reads of traps with it
+                cpu -> pc = op -> pc;
+                *count += k;
+                y86_reg_t valE = decode_execute(cpu, &inst, &cnd, &valA);
+                memory_wb_pc(cpu, &inst, memory, cnd, valA, valE);
+                *count -= k;
+
+                //an input trap that blocked did not retire; the interpreter
+                //runs it again and ends the run there
+                if(inst.icode == IOTRAP && io_current -> blocked) {
+                    return ir_bail(cpu, count, k, op -> pc);
+                }
+                if(cpu -> stat != AOK || ir -> gen != gen) {
+                    return ir_exit(cpu, count, k + 1, cpu -> pc);
+                }
+                break;
+            }
+
+            case (IR_STOP):
+                cpu -> stat = op -> fn;
+                return ir_exit(cpu, count, k, op -> pc);
+        }
+    }
+
+    //the block ran into the next leader
+    ir_op_t *last = &ops[blk -> count - 1];
+    return ir_exit(cpu, count, blk -> count, last -> pc + last -> len);
+}
+
+void ir_free (ir_program_t *ir)
+{
+    if(ir == NULL) {
+        return;
+    }
+    free(ir -> ops);
+    free(ir -> blocks);
+    free(ir -> block);
+    memset(ir, 0, sizeof(ir_program_t));
+}
@@ -0,0 +1,149 @@
+#ifndef __CS261_IR__
+#define __CS261_IR__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+#include "engine.h"
+
+/* IR operations; every decoded instruction becomes exactly one */
+typedef enum {
+    IR_NOP = 0,                 // nothing but the PC
+    IR_MOVI,                    // r[d] = imm
+    IR_MOV,                     // r[d] = r[a]
+    IR_CMOV,                    // if cond(fn): r[d] = r[a]
+    IR_OP,                      // r[d] = r[d] fn r[a], flags
+    IR_OPI,                     // r[d] = r[d] fn imm, flags
+    IR_SET,                     // r[d] = imm, flags = fn (IR_ZF | IR_SF | IR_OF)
+    IR_LOAD,                    // r[d] = M[r[a] + imm] (a == NOREG: M[imm])
+    IR_STORE,                   // M[r[a] + imm] = r[d] (a == NOREG: M[imm])
+    IR_PUSH,                    // M[r[RSP] - 8] = r[a], r[RSP] -= 8
+    IR_POP,                     // r[RSP] += 8, r[d] = M[old r[RSP]]
+    IR_POPF,                    // pop whose value is known to be r[a]
+    IR_JMP,                     // pc = imm
+    IR_BR,                      // if cond(fn): pc = imm
+    IR_CALL,                    // call imm
+    IR_RET,                     // ret
+    IR_EXEC,                    // run through decode_execute/memory_wb_pc
+    IR_STOP                     // recorded invalid instruction: stat = fn
+} ir_kind_t;
+
+/* flag bits of IR_SET */
+#define IR_ZF 0x01
+#define IR_SF 0x02
+#define IR_OF 0x04
+
+/* ir_op_t.flags */
+#define IRF_NOFLAGS 0x01        // the condition codes it sets are never read
+
+/* one IR operation and the instruction it came from */
+typedef struct ir_op {
+
+    uint8_t kind;               // IR_* operation
+    uint8_t fn;                 // ALU function, condition, flag bits or status
+    uint8_t d;                  // destination (stored value for IR_STORE)
+    uint8_t a;                  // source or base register
+    uint8_t flags;              // IRF_* bits
+    uint8_t len;                // length of the instruction (valP - pc)
+    byte_t op;                  // original opcode byte
+    byte_t regs;                // original register byte
+    address_t pc;               // address of the instruction
+    int64_t imm;                // constant, displacement or target
+
+} ir_op_t;
+
+/* straight-line run of operations, entered only at its first */
+typedef struct ir_block {
+    address_t start;            // address of the first instruction
+    address_t end;              // one past the last byte decoded for it
+    uint32_t first;             // index of its first operation
+    uint32_t count;             // number of operations (= instructions)
+} ir_block_t;
+
+/* IR of a whole decoded program */
+typedef struct ir_program {
+
+    ir_op_t *ops;               // operations of all blocks
+    uint32_t numOps;
+    ir_block_t *blocks;         // blocks in address order
+    uint32_t numBlocks;
+    int32_t *block;             // MEMSIZE entries: block starting at an
+                                // address, or -1 (also once invalidated)
+    uint64_t gen;               // bumped whenever a block is invalidated (or
+                                // a watched store must end the block)
+
+    uint32_t folded;            // operations rewritten by each pass
+    uint32_t forwarded;
+    uint32_t deadFlags;
+
+} ir_program_t;
+
+/**
+ * @brief Build the IR of a decoded program
+ *
+ * Blocks start at the entry point, at the targets of jumps and calls, after
+ * every transfer of control, and wherever a chain of decoded instructions
+ * starts. Each decoded instruction becomes one operation that does exactly
+ * what decode_execute and memory_wb_pc do for it; halt, the I/O traps and
+ * memory accesses whose register names NOREG stay IR_EXEC.
+ *
+ * @param prog Decoded program
+ * @param entry Entry point of the program
+ * @param ir Pointer to the IR to be populated
+ * @returns True if the IR could be allocated, false otherwise
+ */
+bool ir_build (y86_decoded_t *prog, address_t entry, ir_program_t *ir);
+
+/**
+ * @brief Run the optimization pipeline over every block
+ *
+ * The passes, in order: load/store forwarding (loads and pops of a value
+ * still held in a register become moves), constant propagation (known
+ * operands become immediates, fully known ALU operations and xor/sub of a
+ * register with itself become IR_SET, known base registers become absolute
+ * addresses), and dead-flag elimination (condition codes overwritten before
+ * any reader or possible exit are not computed). Every operation that can
+ * leave its block early sees exactly the state the interpreter would have.
+ *
+ * @param ir IR to optimize
+ */
+void ir_optimize (ir_program_t *ir);
+
+/**
+ * @brief Drop the blocks decoded from a range of written bytes
+ *
+ * @param ir IR of the program
+ * @param addr First byte written
+ * @param len Number of bytes written
+ */
+void ir_invalidate (ir_program_t *ir, address_t addr, address_t len);
+
+/**
+ * @brief Run one block
+ *
+ * Stops early, with the PC, status and count the interpreter would have, on
+ * a fault, a halt or a store that invalidates decoded code. Stack accesses
+ * outside the address space are left to the interpreter: the block then
+ * returns false with the CPU at the instruction that made them.
+ *
+ * @param ir IR of the program
+ * @param blk Block to run
+ * @param cpu CPU to run, with the PC at the start of the block
+ * @param memory Pointer to the beginning of the Y86 address space
+ * @param count Retired instruction counter to update
+ * @returns False if the instruction at the PC must be run by the interpreter
+ */
+bool ir_run (ir_program_t *ir, ir_block_t *blk, y86_t *cpu, byte_t *memory, uint64_t *count);
+
+/**
+ * @brief Release the IR of a program
+ *
+ * @param ir IR to release
+ */
+void ir_free (ir_program_t *ir);
+
+#endif
@@ -8,6 +8,47 @@
 #include "p2-load.h"
 #include "p3-disas.h"
 #include "p4-interp.h"
+#include "image.h"
+#include "bpred.h"
+#include "pipe.h"
+#include "engine.h"
+#include "cache.h"
+#include "mem.h"
+#include "aot.h"
+#include "ir.h"
+#include "difftest.h"
+#include "ckpt.h"
+#include "debug.h"
+#include "gdb.h"
+#include "sched.h"
+
+/* exit statuses of runs ended by --max-insns, --timeout, --break and --watch */
+#define EXIT_MAXINSNS 2
+#define EXIT_TIMEOUT 3
+#define EXIT_BREAK 4
+
+/* long options without a short form */
+enum {
+    OPT_MAXINSNS = 256, OPT_TIMEOUT, OPT_CHECKPOINT, OPT_EVERY, OPT_RESTORE, OPT_RECORD,
+    OPT_REPLAY, OPT_TRACEFROM, OPT_DEBUG, OPT_BREAK, OPT_WATCH, OPT_GDB, OPT_SERVE
+};
+
+static const struct option longOpts[] = {
+    {"max-insns", required_argument, NULL, OPT_MAXINSNS},
+    {"timeout", required_argument, NULL, OPT_TIMEOUT},
+    {"checkpoint", required_argument, NULL, OPT_CHECKPOINT},
+    {"checkpoint-every", required_argument, NULL, OPT_EVERY},
+    {"restore", required_argument, NULL, OPT_RESTORE},
+    {"record", required_argument, NULL, OPT_RECORD},
+    {"replay", required_argument, NULL, OPT_REPLAY},
+    {"trace-from", required_argument, NULL, OPT_TRACEFROM},
+    {"debug", no_argument, NULL, OPT_DEBUG},
+    {"break", required_argument, NULL, OPT_BREAK},
+    {"watch", required_argument, NULL, OPT_WATCH},
+    {"gdb", required_argument, NULL, OPT_GDB},
+    {"serve", required_argument, NULL, OPT_SERVE},
+    {NULL, 0, NULL, 0}
+};
 
 /*
  * helper function for printing help text
@@ -15,6 +56,7 @@
 void usage (char **argv)
 {
     printf("Usage: %s <option(s)> mini-elf-file\n", argv[0]);
+    printf(" Use - as the file name to read the Mini-ELF from standard input\n");
     printf(" Options are:\n");
     printf("  -h      Display usage\n");
     printf("  -H      Show the Mini-ELF header\n");
@@ -27,6 +69,45 @@ void usage (char **argv)
     printf("  -D      Disassemble data contents\n");
     printf("  -e      Execute program\n");
     printf("  -E      Execute program (trace mode)\n");
+    printf("  -B <p>  Simulate branch prediction (p = nottaken, bimodal, gshare)\n");
+    printf("  -P      Simulate PIPE timing (cycles, CPI and stalls)\n");
+    printf("  -C <d>  Cache validated and pre-decoded images in directory d\n");
+    printf("  -L      Load segments lazily, one page at a time on first access\n");
+    printf("  -X      Enforce segment permissions (violations stop with ADR)\n");
+    printf("  -c      Translate the program to C on standard output\n");
+    printf("  -t      Execute program in lockstep with the reference interpreter\n");
+    printf("  -R <n>  Difftest n random programs (n:seed picks the first seed)\n");
+    printf("  --max-insns <n>  Stop -e and -t after n instructions (exit status %d)\n", EXIT_MAXINSNS);
+    printf("  --timeout <s>    Stop -e and -t after s seconds (exit status %d)\n", EXIT_TIMEOUT);
+    printf("  --checkpoint <f> Checkpoint -e and -t to file f on SIGUSR1\n");
+    printf("  --checkpoint-every <n>  Also checkpoint every n instructions\n");
+    printf("  --restore <f>    Resume execution from checkpoint file f\n");
+    printf("  --record <f>     Log every value the input traps read to file f\n");
+    printf("  --replay <f>     Take the input traps' values from log f, not stdin\n");
+    printf("  --trace-from <n> Run -E at full speed up to instruction n, then trace\n");
+    printf("  --debug          Execute program in a debugger that can step back in time\n");
+    printf("  --break <a>      Stop -e and -t before the instruction at a (exit status %d)\n",
+           EXIT_BREAK);
+    printf("  --watch <a>[:n]  Stop -e and -t after a store into n bytes at a (8)\n");
+    printf("  --gdb <p>        Execute program under gdb, served on local TCP port p\n");
+    printf("                   or, if p is not a number, on Unix socket p\n");
+    printf("  --serve <p>      Run a copy of the program for every connection to local\n");
+    printf("                   TCP port p or Unix socket p, all on one thread; the\n");
+    printf("                   connection is its input and output (--max-insns applies\n");
+    printf("                   to each copy)\n");
+}
+
+/*
+ * engine hooks for the timing and prediction models
+ */
+static void retire_pipe (void *arg, address_t pc, y86_inst_t *inst, bool cnd, address_t next)
+{
+    pipe_retire((pipe_t*)arg, pc, inst, cnd, next);
+}
+
+static void retire_bpred (void *arg, address_t pc, y86_inst_t *inst, bool cnd, address_t next)
+{
+    bpred_update((bpred_t*)arg, pc, inst, cnd, next);
 }
 
 int main (int argc, char **argv)
@@ -41,6 +122,33 @@ int main (int argc, char **argv)
     bool D = false;
     bool e = false;
     bool E = false;
+    bool B = false;
+    bool P = false;
+    bool L = false;
+    bool X = false;
+    bool c = false;
+    bool t = false;
+    uint64_t randoms = 0;
+    uint64_t seed = 1;
+    uint64_t maxInsns = 0;
+    double timeout = 0;
+    char *ckptFile = NULL;
+    uint64_t ckptEvery = 0;
+    char *restoreFile = NULL;
+    char *recordFile = NULL;
+    char *replayFile = NULL;
+    uint64_t traceFrom = 0;
+    bool debug = false;
+    char *gdbWhere = NULL;
+    char *serveWhere = NULL;
+    address_t brks[DEBUG_POINTS];
+    uint32_t numBrks = 0;
+    address_t watches[DEBUG_POINTS];
+    address_t watchLens[DEBUG_POINTS];
+    uint32_t numWatches = 0;
+    char *end = NULL;
+    bpred_model_t model = BP_NOTTAKEN;
+    char* cacheDir = NULL;
 
     const int memsize = 4096;
 
@@ -51,7 +159,7 @@ int main (int argc, char **argv)
 
     int opt;
     //check command line args
-    while((opt = getopt(argc, argv, "hHafsmMdDeE")) != -1) {
+    while((opt = getopt_long(argc, argv, "hHafsmMdDeEB:PC:LXctR:", longOpts, NULL)) != -1) {
         switch(opt) {
             case 'h':
                 h = true;
@@ -101,11 +209,162 @@ int main (int argc, char **argv)
                 E = true;
                 break;
 
+            case 'B':
+                if(!bpred_parse(optarg, &model)) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                B = true;
+                break;
+
+            case 'P':
+                P = true;
+                break;
+
+            case 'C':
+                cacheDir = optarg;
+                break;
+
+            case 'L':
+                L = true;
+                break;
+
+            case 'X':
+                X = true;
+                break;
+
+            case 'c':
+                c = true;
+                break;
+
+            case 't':
+                t = true;
+                break;
+
+            case 'R':
+                randoms = strtoull(optarg, &end, 0);
+                if(*end == ':') {
+                    seed = strtoull(end + 1, &end, 0);
+                }
+                if(*end != '\0' || randoms == 0) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case OPT_MAXINSNS:
+                maxInsns = strtoull(optarg, &end, 0);
+                if(*end != '\0' || maxInsns == 0) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case OPT_TIMEOUT:
+                timeout = strtod(optarg, &end);
+                if(*end != '\0' || !(timeout > 0)) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case OPT_CHECKPOINT:
+                ckptFile = optarg;
+                break;
+
+            case OPT_EVERY:
+                ckptEvery = strtoull(optarg, &end, 0);
+                if(*end != '\0' || ckptEvery == 0) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case OPT_RESTORE:
+                restoreFile = optarg;
+                break;
+
+            case OPT_RECORD:
+                recordFile = optarg;
+                break;
+
+            case OPT_REPLAY:
+                replayFile = optarg;
+                break;
+
+            case OPT_TRACEFROM:
+                traceFrom = strtoull(optarg, &end, 0);
+                if(*end != '\0') {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case OPT_DEBUG:
+                debug = true;
+                e = true;
+                break;
+
+            case OPT_GDB:
+                gdbWhere = optarg;
+                e = true;
+                break;
+
+            case OPT_SERVE:
+                serveWhere = optarg;
+                break;
+
+            case OPT_BREAK:
+                if(numBrks == DEBUG_POINTS) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                brks[numBrks] = strtoull(optarg, &end, 0);
+                if(*end != '\0' || brks[numBrks] >= MEMSIZE) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                numBrks++;
+                break;
+
+            case OPT_WATCH:
+                if(numWatches == DEBUG_POINTS) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                watches[numWatches] = strtoull(optarg, &end, 0);
+                watchLens[numWatches] = 8;
+                if(*end == ':') {
+                    watchLens[numWatches] = strtoull(end + 1, &end, 0);
+                }
+                if(*end != '\0' || watches[numWatches] >= MEMSIZE || watchLens[numWatches] == 0) {
+                    usage(argv);
+                    free(memory);
+                    return EXIT_FAILURE;
+                }
+                numWatches++;
+                break;
+
             default:
                 usage(argv);
                 break;
         }
     }
+    //random programs need no file
+    if(randoms > 0) {
+        free(memory);
+        return difftest_random(randoms, seed) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     //set filename iff only one name is present
     if(optind + 1 == argc) {
         filename = argv[optind];
@@ -115,46 +374,109 @@ int main (int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    //open and check the file
-    FILE* file = fopen(filename, "r");
     if(h) {
         free(memory);
         return EXIT_SUCCESS;
     }
 
-    if(file == NULL) {
-        printf("Failed to read file\n");
-        free(memory);
-        return EXIT_FAILURE;
+    //a restored address space is not the image's, so it is loaded eagerly
+    //and never cached
+    if(restoreFile != NULL) {
+        cacheDir = NULL;
+        L = false;
     }
 
-    //check for header validity
-    if(!read_header(file, &header)) {
-        fclose(file);
-        free(memory);
+    //every served program starts from a copy of the loaded address space
+    if(serveWhere != NULL) {
+        L = false;
+    }
+
+    //map the file once; a cache hit skips validation and decoding entirely
+    elf_image_t image;
+    cache_t cached;
+    bool hit = false;
+    memset(&cached, 0, sizeof(cache_t));
+    image_stat_t status = image_map(filename, &image);
+    if(status == IMG_OK && cacheDir != NULL) {
+        hit = cache_lookup(cacheDir, &image, &cached);
+    }
+
+    //otherwise validate all headers in a single pass
+    if(status == IMG_OK && !hit) {
+        status = image_parse(&image);
+    }
+    if(status != IMG_OK) {
+        //header errors are reported twice, once by the loader and once here
+        if(status == IMG_BADHDR || status == IMG_BADPHDR) {
+            printf("Failed to read file\n");
+        }
         printf("Failed to read file\n");
+        image_close(&image);
+        free(memory);
         return EXIT_FAILURE;
     }
+    header = hit ? cached.hdr -> hdr : image.hdr;
 
-    //populate the p_headers array
+    //full-width view of the headers (version 1 files are widened)
+    elf_hdr2_t header2 = hit ? cached.hdr -> hdr2 : image.hdr2;
+    elf_phdr2_t *p_headers2 = hit ? cached.phdrs2 : image.phdrs2;
+
+    //populate the p_headers array, memory and the decoded program
     elf_phdr_t p_headers[header.e_num_phdr];
-    memset(p_headers, 0, header.e_num_phdr* sizeof(elf_phdr_t));
-    int offset = header.e_phdr_start;
-    for(int i = 0; i < header.e_num_phdr; i++) {
-        if(!read_phdr(file, offset, &p_headers[i])) {
-            free(memory);
-            printf("Failed to read file\n");
-            return EXIT_FAILURE;
+    y86_decoded_t prog;
+    y86_mem_t pages;
+    y86_t resume;
+    uint64_t resumeCount = 0;
+    memset(&prog, 0, sizeof(y86_decoded_t));
+    mem_init(&pages, memory);
+    mem_current = &pages;
+    if(hit) {
+        memcpy(p_headers, cached.phdrs, header.e_num_phdr * sizeof(elf_phdr_t));
+        memcpy(memory, cached.memory, memsize);
+        cache_decoded(&cached, &prog);
+    } else {
+        memcpy(p_headers, image.phdrs, header.e_num_phdr * sizeof(elf_phdr_t));
+
+        //demand paging keeps the image open and copies nothing yet; cache
+        //entries need the fully loaded address space, so -C loads eagerly
+        if(L && cacheDir == NULL) {
+            mem_lazy(&pages, &image);
+        } else {
+            image_load(&image, memory);
         }
-        offset += 20;
-    }
 
-    for(int i = 0; i < header.e_num_phdr; i++) {
-        if(!load_segment(file, memory, &p_headers[i])) {
+        //code is decoded from the restored memory
+        if(restoreFile != NULL && !ckpt_restore(restoreFile, &image, memory, &resume, &resumeCount)) {
+            printf("Failed to read checkpoint\n");
+            image_close(&image);
             free(memory);
-            printf("Failed to read file\n");
             return EXIT_FAILURE;
         }
+
+        if(e || c || t || traceFrom > 0 || cacheDir != NULL || serveWhere != NULL) {
+            decode_program(memory, p_headers, header.e_num_phdr, &prog);
+        }
+        if(cacheDir != NULL) {
+            cache_store(cacheDir, &image, memory, &prog);
+        }
+    }
+
+    //optimized blocks for the engine and the translator
+    ir_program_t irp;
+    memset(&irp, 0, sizeof(ir_program_t));
+    if(e || c || t || traceFrom > 0) {
+        ir_build(&prog, header2.e_entry, &irp);
+        ir_optimize(&irp);
+    }
+
+    //segment permissions are checked through the page table
+    if(X) {
+        mem_protect(&pages, p_headers, header.e_num_phdr);
+    }
+
+    //memory dumps read the address space directly
+    if(m || M || d || D) {
+        mem_fault_all(mem_current);
     }
 
     //conditional handling for flags
@@ -165,12 +487,20 @@ int main (int argc, char **argv)
     }
 
     if(H) {
-        dump_header(&header);
+        if(header2.e_version == 2) {
+            dump_header2(&header2);
+        } else {
+            dump_header(&header);
+        }
     }
     //may need to add flags for a and f, reassess after testing
 
     if(s) {
-        dump_phdrs(header.e_num_phdr, p_headers);
+        if(p_headers2 != NULL) {
+            dump_phdrs2(header2.e_num_phdr, p_headers2);
+        } else {
+            dump_phdrs(header.e_num_phdr, p_headers);
+        }
     }
 
     if(m) {
@@ -205,7 +535,20 @@ int main (int argc, char **argv)
         }
     }
 
-    if(e && E) {
+    if(c) {
+        mem_fault_all(mem_current);
+        aot_emit(memory, &irp, header2.e_entry, filename);
+    }
+
+    //the debuggers own the engine's tick and limits (and --debug runs
+    //history again)
+    if(((e || t) && E) || (recordFile != NULL && replayFile != NULL) ||
+            (debug && (t || P || B || ckptFile != NULL || recordFile != NULL || maxInsns > 0 ||
+                       timeout > 0)) ||
+            (gdbWhere != NULL && (t || debug || ckptFile != NULL || maxInsns > 0 || timeout > 0)) ||
+            (serveWhere != NULL && (e || E || t || P || B || ckptFile != NULL || recordFile != NULL ||
+                                    replayFile != NULL || timeout > 0 || numBrks > 0 ||
+                                    numWatches > 0))) {
         free(memory);
         usage(argv);
         return EXIT_FAILURE;
@@ -215,7 +558,7 @@ int main (int argc, char **argv)
     y86_t cpu;
     memset(&cpu, 0, sizeof(y86_t));
     cpu.stat = AOK;
-    cpu.pc = header.e_entry;
+    cpu.pc = header2.e_entry;
     cpu.zf = false;
     cpu.of = false;
     cpu.sf = false;
@@ -224,6 +567,34 @@ int main (int argc, char **argv)
     for(int i = 0; i < 15; i++) {
         cpu.reg[i] = 0x0;
     }
+    if(restoreFile != NULL) {
+        cpu = resume;
+    }
+
+    //input traps can be recorded to a log or replayed from one
+    if((recordFile != NULL && !io_record(io_current, recordFile)) ||
+            (replayFile != NULL && !io_replay(io_current, replayFile))) {
+        printf("Failed to open %s\n", recordFile != NULL ? recordFile : replayFile);
+        ir_free(&irp);
+        free_decoded(&prog);
+        cache_close(&cached);
+        image_close(&image);
+        free(memory);
+        return EXIT_FAILURE;
+    }
+    io_replay_skip(io_current, resumeCount);
+
+    //history run again by the debugger, and input traps run again on the
+    //difftest reference, read what the first run read
+    if((debug || (t && recordFile == NULL)) && replayFile == NULL && !io_tape(io_current)) {
+        printf("Failed to start the %s\n", debug ? "debugger" : "difftest");
+        ir_free(&irp);
+        free_decoded(&prog);
+        cache_close(&cached);
+        image_close(&image);
+        free(memory);
+        return EXIT_FAILURE;
+    }
 
     //more setup use memset for inst
     y86_inst_t inst;
@@ -231,32 +602,163 @@ int main (int argc, char **argv)
     bool cond = false;
     y86_reg_t valA = 0;
     y86_reg_t valE = 0;
+    address_t pc = 0;
 
-    if(e) {//Execute mode
-        printf("Beginning execution at 0x%04x\n", header.e_entry);
-        int numIns = 0;
-        while(cpu.stat == AOK) {
-            inst = fetch(&cpu, memory);
+    //branch predictor fed by every executed instruction
+    bpred_t *bp = NULL;
+    if(B) {
+        bp = (bpred_t*)calloc(1, sizeof(bpred_t));
+        bpred_init(bp, model);
+    }
 
-            //invalid instruction
-            if(cpu.stat == ADR || cpu.stat == INS) {
-                break;
-            }
+    //pipeline timing model riding on the functional engine
+    pipe_t pp;
+    pipe_init(&pp, bp);
+
+    bool diverged = false;
+    engine_limit_t limited = ENG_RUNNING;
+    if(serveWhere != NULL) {//Serve mode
+        sched_t sch;
+        sched_init(&sch, &cpu, memory, &prog, resumeCount, maxInsns);
+        if(sched_listen(&sch, serveWhere)) {
+            printf("Serving %s on %s\n", filename, serveWhere);
+            fflush(stdout);
+            sched_serve(&sch);
+            printf("Served %" PRIu64 " programs (%" PRIu64 " at once at most)\n", sch.served, sch.peak);
+        } else {
+            printf("Failed to listen on %s\n", serveWhere);
+        }
+        sched_free(&sch);
+    }
 
-            //remaining von-neumann
-            valE = decode_execute (&cpu, &inst, &cond, &valA);
-            memory_wb_pc (&cpu, &inst, memory, cond, valA, valE);
-            numIns++;
+    if(e || t) {//Execute mode
+        if(restoreFile != NULL) {
+            printf("Resuming execution at 0x%04" PRIx64 "\n", cpu.pc);
+        } else {
+            printf("Beginning execution at 0x%04" PRIx64 "\n", header2.e_entry);
+        }
+        engine_t eng;
+        engine_init(&eng, &cpu, memory, &prog);
+        eng.ir = &irp;
+        eng.count = resumeCount;
+        if(P) {
+            eng.hook = retire_pipe;
+            eng.hookArg = &pp;
+        } else if(B) {
+            eng.hook = retire_bpred;
+            eng.hookArg = bp;
+        }
+        engine_limits(&eng, maxInsns, timeout);
+        io_current -> clock = &(eng.count);
+        io_current -> deadline = eng.deadline;
+        for(uint32_t i = 0; i < numBrks; i++) {
+            engine_break(&eng, brks[i], true);
+        }
+        for(uint32_t i = 0; i < numWatches; i++) {
+            engine_watch(&eng, watches[i], watchLens[i], true);
+        }
+
+        //periodic and on-demand checkpoints, written by another thread
+        ckpt_t *ck = NULL;
+        if(ckptFile != NULL) {
+            ck = (ckpt_t*)calloc(1, sizeof(ckpt_t));
+            if(ck == NULL || !ckpt_start(ck, ckptFile, &image, &eng, ckptEvery)) {
+                printf("Failed to start checkpoints\n");
+            }
+        }
+        if(t) {
+            difftest_t dt;
+            diverged = !difftest_init(&dt, &eng) || !difftest_run(&dt, &eng, 0);
+            difftest_free(&dt);
+        } else if(debug) {
+            debug_t dbg;
+            if(debug_init(&dbg, &eng, DEBUG_SNAPSHOT)) {
+                //the debugger keeps the points so that going back can
+                //set its own ones for a while
+                engine_free(&eng);
+                for(uint32_t i = 0; i < numBrks; i++) {
+                    debug_break(&dbg, brks[i]);
+                }
+                for(uint32_t i = 0; i < numWatches; i++) {
+                    debug_watch(&dbg, watches[i], watchLens[i]);
+                }
+                debug_shell(&dbg);
+            } else {
+                printf("Failed to start the debugger\n");
+            }
+            debug_free(&dbg);
+        } else if(gdbWhere != NULL) {
+            gdb_t gdb;
+            if(gdb_listen(&gdb, gdbWhere)) {
+                printf("Waiting for gdb on %s\n", gdbWhere);
+                fflush(stdout);
+                gdb_serve(&gdb, &eng);
+            } else {
+                printf("Failed to listen on %s\n", gdbWhere);
+            }
+            gdb_close(&gdb);
+        } else {
+            engine_run(&eng);
+        }
+        if(!debug && gdbWhere == NULL) {
+            debug_report(&eng);
+        }
+        engine_free(&eng);
+        ckpt_stop(ck);
+        free(ck);
+        io_current -> clock = NULL;
+        io_current -> deadline = 0;
+        limited = debug || gdbWhere != NULL ? ENG_RUNNING : eng.limited;
+        if(limited == ENG_MAXINSNS) {
+            printf("Stopped after %" PRIu64 " instructions (--max-insns)\n", eng.count);
+        } else if(limited == ENG_TIMEOUT) {
+            printf("Stopped after %g seconds (--timeout)\n", timeout);
         }
         dump_cpu_state(&cpu);
-        printf("Total execution count: %d\n", numIns);
+        printf("Total execution count: %" PRIu64 "\n", eng.count);
+        mem_fault_all(mem_current);
+        if(P) {
+            pipe_dump(&pp);
+        }
+        if(B) {
+            bpred_dump(bp);
+        }
     }
 
     if(E) {//Trace mode
-        printf("Beginning execution at 0x%04x\n", header.e_entry);
+        if(restoreFile != NULL) {
+            printf("Resuming execution at 0x%04" PRIx64 "\n", cpu.pc);
+        } else {
+            printf("Beginning execution at 0x%04" PRIx64 "\n", header2.e_entry);
+        }
+        uint64_t numIns = resumeCount;
+
+        //run at full speed up to the instruction of interest
+        if(traceFrom > numIns) {
+            engine_t eng;
+            engine_init(&eng, &cpu, memory, &prog);
+            eng.ir = &irp;
+            eng.count = numIns;
+            if(P) {
+                eng.hook = retire_pipe;
+                eng.hookArg = &pp;
+            } else if(B) {
+                eng.hook = retire_bpred;
+                eng.hookArg = bp;
+            }
+            engine_limits(&eng, traceFrom, 0);
+            io_current -> clock = &(eng.count);
+            engine_run(&eng);
+            numIns = eng.count;
+
+            //the tracer fetches everything, so nothing is left to invalidate
+            mem_current -> onCode = NULL;
+            printf("Tracing from instruction %" PRIu64 "\n", numIns);
+        }
+        io_current -> clock = &numIns;
+
         dump_cpu_state(&cpu);
         printf("\n");
-        int numIns = 0;
         while(cpu.stat == AOK) {
             inst = fetch(&cpu, memory);
 
@@ -273,8 +775,14 @@ int main (int argc, char **argv)
             printf("\n");
 
             //remining von-neumann
+            pc = cpu.pc;
             valE = decode_execute (&cpu, &inst, &cond, &valA);
             memory_wb_pc (&cpu, &inst, memory, cond, valA, valE);
+            if(P) {
+                pipe_retire(&pp, pc, &inst, cond, cpu.pc);
+            } else if(B) {
+                bpred_update(bp, pc, &inst, cond, cpu.pc);
+            }
             dump_cpu_state(&cpu);
 
             if(cpu.stat == AOK) {
@@ -282,11 +790,39 @@ int main (int argc, char **argv)
             }
             numIns++;
         }
-        printf("Total execution count: %d\n\n", numIns);
+        io_current -> clock = NULL;
+        printf("Total execution count: %" PRIu64 "\n\n", numIns);
+        mem_fault_all(mem_current);
         dump_memory(memory, 0, memsize);
+        if(P) {
+            pipe_dump(&pp);
+        }
+        if(B) {
+            bpred_dump(bp);
+        }
     }
 
+    //a replay that strayed from its log is reported like a divergence
+    if(!io_close(io_current)) {
+        printf("Failed to write %s\n", recordFile);
+    }
+    if(io_current -> mismatch) {
+        printf("Replay diverged from the log at instruction %" PRIu64 "\n", io_current -> mismatchAt);
+        diverged = true;
+    }
+
+    free(bp);
+    ir_free(&irp);
+    free_decoded(&prog);
+    cache_close(&cached);
+    image_close(&image);
     free(memory);
-    return EXIT_SUCCESS;
+    if(diverged) {
+        return EXIT_FAILURE;
+    }
+    if(limited == ENG_BREAK || limited == ENG_WATCH) {
+        return EXIT_BREAK;
+    }
+    return limited == ENG_MAXINSNS ? EXIT_MAXINSNS : limited == ENG_TIMEOUT ? EXIT_TIMEOUT : EXIT_SUCCESS;
 }
 
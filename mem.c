@@ -0,0 +1,213 @@
+/*
+ * Y86 address space page table
+ *
+ * Name: Griffin Moran
+ */
+
+#include "mem.h"
+
+y86_mem_t *mem_current = NULL;
+
+/*
+Fill one page from every segment overlapping it, in program header order so
+that later segments win just like they do when loading eagerly.
+*/
+static void mem_page_in (y86_mem_t *mem, uint32_t p)
+{
+    elf_image_t *img = mem -> img;
+    address_t lo = (address_t)p << PAGEBITS;
+    address_t hi = lo + PAGESIZE;
+
+    mem -> page[p] |= PG_PRESENT;
+    if(img == NULL) {
+        return;
+    }
+    mem -> faults++;
+
+    for(int i = 0; i < img -> hdr.e_num_phdr; i++) {
+        elf_phdr_t *phdr = &(img -> phdrs[i]);
+        address_t start = phdr -> p_vaddr > lo ? phdr -> p_vaddr : lo;
+        address_t end = (address_t)phdr -> p_vaddr + phdr -> p_size;
+        if(end > hi) {
+            end = hi;
+        }
+        if(start >= end) {
+            continue;
+        }
+
+        const byte_t *src = image_segment(img, i) + (start - phdr -> p_vaddr);
+        size_t len = end - start;
+
+        //memory starts zeroed, so all-zero stack bytes need no copy
+        if(phdr -> p_type == STACK) {
+            size_t z = 0;
+            while(z < len && src[z] == 0) {
+                z++;
+            }
+            if(z == len) {
+                continue;
+            }
+        }
+        memcpy(mem -> memory + start, src, len);
+    }
+}
+
+void mem_init (y86_mem_t *mem, byte_t *memory)
+{
+    if(mem == NULL) {
+        return;
+    }
+    memset(mem, 0, sizeof(y86_mem_t));
+    mem -> memory = memory;
+    memset(mem -> page, PG_PRESENT, sizeof(mem -> page));
+}
+
+void mem_lazy (y86_mem_t *mem, elf_image_t *img)
+{
+    if(mem == NULL || img == NULL) {
+        return;
+    }
+    mem -> img = img;
+    for(int p = 0; p < NUMPAGES; p++) {
+        mem -> page[p] &= ~PG_PRESENT;
+    }
+}
+
+void mem_fault (address_t addr, address_t len)
+{
+    y86_mem_t *mem = mem_current;
+    if(mem == NULL || len == 0 || addr >= MEMSIZE) {
+        return;
+    }
+
+    address_t last = addr + len - 1;
+    if(last >= MEMSIZE || last < addr) {
+        last = MEMSIZE - 1;
+    }
+
+    for(address_t p = addr >> PAGEBITS; p <= (last >> PAGEBITS); p++) {
+        if(!(mem -> page[p] & PG_PRESENT)) {
+            mem_page_in(mem, p);
+        }
+    }
+}
+
+void mem_fault_all (y86_mem_t *mem)
+{
+    if(mem == NULL) {
+        return;
+    }
+    for(int p = 0; p < NUMPAGES; p++) {
+        if(!(mem -> page[p] & PG_PRESENT)) {
+            mem_page_in(mem, p);
+        }
+    }
+}
+
+void mem_protect (y86_mem_t *mem, elf_phdr_t *phdrs, uint16_t numphdrs)
+{
+    if(mem == NULL || (phdrs == NULL && numphdrs > 0)) {
+        return;
+    }
+
+    uint8_t covered[NUMPAGES];
+    memset(covered, 0, sizeof(covered));
+    for(int p = 0; p < NUMPAGES; p++) {
+        mem -> page[p] &= ~(PG_R | PG_W | PG_X);
+    }
+
+    for(int i = 0; i < numphdrs; i++) {
+        uint8_t bits = 0;
+        if(phdrs[i].p_flags & 4) {
+            bits |= PG_R;
+        }
+        if(phdrs[i].p_flags & 2) {
+            bits |= PG_W;
+        }
+        if(phdrs[i].p_flags & 1) {
+            bits |= PG_X;
+        }
+
+        address_t start = phdrs[i].p_vaddr;
+        address_t end = (address_t)phdrs[i].p_vaddr + phdrs[i].p_size;
+        if(end > MEMSIZE) {
+            end = MEMSIZE;
+        }
+        for(address_t a = start & ~(address_t)(PAGESIZE - 1); a < end; a += PAGESIZE) {
+            mem -> page[a >> PAGEBITS] |= bits;
+            covered[a >> PAGEBITS] = 1;
+        }
+    }
+
+    //the rest of the address space is plain data (e.g., the stack below the
+    //STACK segment's address, where %rsp starts)
+    for(int p = 0; p < NUMPAGES; p++) {
+        if(!covered[p]) {
+            mem -> page[p] |= PG_R | PG_W;
+        }
+    }
+    mem -> enforce = true;
+}
+
+void mem_mark_code (y86_mem_t *mem, address_t addr, address_t len)
+{
+    if(mem == NULL || len == 0 || addr >= MEMSIZE) {
+        return;
+    }
+
+    address_t last = addr + len - 1;
+    if(last >= MEMSIZE || last < addr) {
+        last = MEMSIZE - 1;
+    }
+    for(address_t p = addr >> PAGEBITS; p <= (last >> PAGEBITS); p++) {
+        mem -> page[p] |= PG_CODE;
+    }
+}
+
+void mem_clean (y86_mem_t *mem)
+{
+    if(mem == NULL) {
+        return;
+    }
+    for(int p = 0; p < NUMPAGES; p++) {
+        mem -> page[p] &= ~PG_DIRTY;
+    }
+}
+
+void mem_code_store (address_t addr, address_t len)
+{
+    y86_mem_t *mem = mem_current;
+    if(mem == NULL) {
+        return;
+    }
+    address_t last = addr + len - 1 < MEMSIZE ? addr + len - 1 : MEMSIZE - 1;
+    uint8_t bits = mem -> page[addr >> PAGEBITS] | mem -> page[last >> PAGEBITS];
+    if(bits & PG_CODE) {
+        mem -> smc++;
+        if(mem -> onCode != NULL) {
+            mem -> onCode(mem -> onCodeArg, addr, len);
+        }
+    }
+    if((bits & PG_WATCH) && mem -> onWatch != NULL) {
+        mem -> onWatch(mem -> onWatchArg, addr, len);
+    }
+}
+
+bool mem_check (y86_mem_t *mem, address_t addr, address_t len, uint8_t bits)
+{
+    if(mem == NULL || !mem -> enforce || len == 0) {
+        return true;
+    }
+
+    address_t last = addr + len - 1;
+    if(addr >= MEMSIZE || last >= MEMSIZE || last < addr) {
+        return false;
+    }
+
+    for(address_t p = addr >> PAGEBITS; p <= (last >> PAGEBITS); p++) {
+        if((mem -> page[p] & bits) != bits) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,186 @@
+#ifndef __CS261_MEM__
+#define __CS261_MEM__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "y86.h"
+#include "image.h"
+
+/* page state bits */
+#define PG_PRESENT 0x01         // page contents are in guest memory
+#define PG_R       0x02         // page belongs to a readable segment
+#define PG_W       0x04         // page belongs to a writable segment
+#define PG_X       0x08         // page belongs to an executable segment
+#define PG_CODE    0x10         // page holds pre-decoded instructions
+#define PG_DIRTY   0x20         // page was written since mem_clean
+#define PG_WATCH   0x40         // page holds watched bytes
+
+/* told about every store into a PG_CODE (or PG_WATCH) page */
+typedef void (*mem_code_hook_t) (void *arg, address_t addr, address_t len);
+
+/* per-page view of the Y86 address space */
+typedef struct y86_mem {
+
+    byte_t *memory;             // Y86 address space
+    uint8_t page[NUMPAGES];     // state bits of every page
+
+    elf_image_t *img;           // image supplying pages on demand
+
+    uint64_t faults;            // pages brought in on first access
+
+    bool enforce;               // R/W/X bits are checked on every access
+
+    mem_code_hook_t onCode;     // invalidates cached code on a store into it
+    void *onCodeArg;            // argument passed to onCode
+    uint64_t smc;               // stores that hit a PG_CODE page
+
+    mem_code_hook_t onWatch;    // told about stores into PG_WATCH pages
+    void *onWatchArg;           // argument passed to onWatch
+
+} y86_mem_t;
+
+/* page table consulted by fetch and memory_wb_pc, or NULL when off */
+extern y86_mem_t *mem_current;
+
+/**
+ * @brief Set up a page table with every page present
+ *
+ * @param mem Pointer to the page table
+ * @param memory Pointer to the beginning of the Y86 address space
+ */
+void mem_init (y86_mem_t *mem, byte_t *memory);
+
+/**
+ * @brief Switch a page table to demand paging from a validated image
+ *
+ * Nothing is copied up front; each page is filled from the segments that
+ * cover it the first time fetch or memory_wb_pc touches it, and counted as a
+ * fault. Pages the program never touches are never copied from the image,
+ * and all-zero STACK bytes are skipped since memory starts zeroed. The
+ * address space is still allocated in full, so this saves copying, not
+ * memory.
+ *
+ * @param mem Pointer to the page table
+ * @param img Validated image that must stay open while the table is in use
+ */
+void mem_lazy (y86_mem_t *mem, elf_image_t *img);
+
+/**
+ * @brief Bring in any missing pages of a range of addresses
+ *
+ * @param addr First address accessed
+ * @param len Number of bytes accessed
+ */
+void mem_fault (address_t addr, address_t len);
+
+/**
+ * @brief Bring in every missing page (e.g., before dumping memory)
+ *
+ * @param mem Pointer to the page table
+ */
+void mem_fault_all (y86_mem_t *mem);
+
+/**
+ * @brief Build the R/W/X bits of every page from the program headers
+ *
+ * A page takes the union of the permissions of all segments overlapping it,
+ * so permissions are only as fine-grained as PAGESIZE; pages no segment
+ * covers are readable and writable but not executable. Once set up, fetch
+ * requires X, and memory_wb_pc requires R for loads and W for stores; a
+ * violation stops the CPU with ADR.
+ *
+ * @param mem Pointer to the page table
+ * @param phdrs Program headers of the loaded program
+ * @param numphdrs Number of program headers
+ */
+void mem_protect (y86_mem_t *mem, elf_phdr_t *phdrs, uint16_t numphdrs);
+
+/**
+ * @brief Mark the pages of a range of addresses as holding cached code
+ *
+ * @param mem Pointer to the page table
+ * @param addr First address of the cached instruction(s)
+ * @param len Number of bytes they depend on
+ */
+void mem_mark_code (y86_mem_t *mem, address_t addr, address_t len);
+
+/**
+ * @brief Clear the PG_DIRTY bit of every page
+ *
+ * @param mem Pointer to the page table
+ */
+void mem_clean (y86_mem_t *mem);
+
+/**
+ * @brief Report a store into a PG_CODE or PG_WATCH page (the slow half of
+ * mem_store)
+ *
+ * @param addr First address written
+ * @param len Number of bytes written
+ */
+void mem_code_store (address_t addr, address_t len);
+
+/**
+ * @brief Check that every page of a range of addresses has the given bits
+ *
+ * @param mem Pointer to the page table
+ * @param addr First address accessed
+ * @param len Number of bytes accessed
+ * @param bits PG_R, PG_W and/or PG_X
+ * @returns True if the whole range lies in memory and has all the bits
+ */
+bool mem_check (y86_mem_t *mem, address_t addr, address_t len, uint8_t bits);
+
+/*
+Called before every guest memory access; costs a single test unless pages
+are being loaded on demand.
+*/
+static inline void mem_touch (address_t addr, address_t len)
+{
+    if(mem_current != NULL && mem_current -> img != NULL) {
+        mem_fault(addr, len);
+    }
+}
+
+/*
+Write barrier called after every guest store: marks the pages dirty, and a
+store that stays off code and watched pages costs nothing more than one mask.
+*/
+static inline void mem_store (address_t addr, address_t len)
+{
+    y86_mem_t *mem = mem_current;
+    if(mem == NULL || addr >= MEMSIZE) {
+        return;
+    }
+    address_t last = addr + len - 1 < MEMSIZE ? addr + len - 1 : MEMSIZE - 1;
+    uint8_t *first = &(mem -> page[addr >> PAGEBITS]);
+    uint8_t *end = &(mem -> page[last >> PAGEBITS]);
+    *first |= PG_DIRTY;
+    *end |= PG_DIRTY;
+    if((*first | *end) & (PG_CODE | PG_WATCH)) {
+        mem_code_store(addr, len);
+    }
+}
+
+/*
+Permission check for an access; always allowed unless mem_protect was used.
+Accesses that stay within one page cost one load and one mask.
+*/
+static inline bool mem_allowed (address_t addr, address_t len, uint8_t bits)
+{
+    y86_mem_t *mem = mem_current;
+    if(mem == NULL || !mem -> enforce) {
+        return true;
+    }
+    if(addr < MEMSIZE && (addr & (PAGESIZE - 1)) + len <= PAGESIZE) {
+        return (mem -> page[addr >> PAGEBITS] & bits) == bits;
+    }
+    return mem_check(mem, addr, len, bits);
+}
+
+#endif
@@ -49,7 +49,7 @@ bool read_header (FILE *file, elf_hdr_t *hdr) //needs the most work
 
     fread(&(hdr -> e_strtab), sizeof(char) * 2, 1, file);
 
-    fread(&(hdr -> magic), sizeof(char) * 8, 1, file);
+    fread(&(hdr -> magic), sizeof(char) * 4, 1, file);
 
     //convert expected string to integer
     const int magic_expect = 4607045;
@@ -64,6 +64,50 @@ bool read_header (FILE *file, elf_hdr_t *hdr) //needs the most work
     return true;
 }
 
+bool read_header2 (FILE *file, elf_hdr2_t *hdr)
+{
+    if(file == NULL || hdr == NULL) {
+        return false;
+    }
+
+    //peek at the version to pick the layout
+    uint16_t version = 0;
+    fseek(file, 0L, SEEK_SET);
+    if(fread(&version, sizeof(version), 1, file) != 1) {
+        printf("Failed to read file\n");
+        return false;
+    }
+    fseek(file, 0L, SEEK_SET);
+
+    //version 1 headers are widened field by field
+    if(version == 1) {
+        elf_hdr_t v1;
+        if(!read_header(file, &v1)) {
+            return false;
+        }
+        memset(hdr, 0, sizeof(elf_hdr2_t));
+        hdr -> e_version = v1.e_version;
+        hdr -> e_hdrsize = sizeof(elf_hdr_t);
+        hdr -> e_num_phdr = v1.e_num_phdr;
+        hdr -> e_entry = v1.e_entry;
+        hdr -> e_phdr_start = v1.e_phdr_start;
+        hdr -> e_symtab = v1.e_symtab;
+        hdr -> e_strtab = v1.e_strtab;
+        hdr -> e_phentsize = sizeof(elf_phdr_t);
+        hdr -> magic = v1.magic;
+        return true;
+    }
+
+    //version 2 headers are aligned and need a single read
+    if(version != 2 || fread(hdr, sizeof(elf_hdr2_t), 1, file) != 1 ||
+            hdr -> e_hdrsize != sizeof(elf_hdr2_t) || hdr -> e_phentsize != sizeof(elf_phdr2_t) ||
+            hdr -> e_phdr_start % 8 != 0 || hdr -> magic != 0x464C45) {
+        printf("Failed to read file\n");
+        return false;
+    }
+    return true;
+}
+
 void usage_p1 (char **argv)
 {
     printf("Usage: %s <option(s)> mini-elf-file\n", argv[0]);
@@ -159,3 +203,36 @@ void dump_header (elf_hdr_t *hdr)
     }
 }
 
+void dump_header2 (elf_hdr2_t *hdr)
+{
+    byte_t *bytes = (byte_t*)hdr;
+    for(size_t i = 0; i < sizeof(elf_hdr2_t); i++) {
+        printf("%02x", bytes[i]);
+        if(i % 16 == 15) {
+            printf("\n");
+        } else if(i % 8 == 7) {
+            printf("  ");
+        } else {
+            printf(" ");
+        }
+    }
+
+    printf("Mini-ELF version %d\n", hdr -> e_version);
+    printf("Entry point 0x%02" PRIx64 "\n", hdr -> e_entry);
+    printf("There are %" PRIu32 " program headers, starting at offset %" PRIu64 " (0x%02" PRIx64 ")\n",
+           hdr -> e_num_phdr, hdr -> e_phdr_start, hdr -> e_phdr_start);
+
+    if(!hdr -> e_symtab) {
+        printf("There is no symbol table present\n");
+    } else {
+        printf("There is a symbol table starting at offset %" PRIu64 " (0x%02" PRIx64 ")\n",
+               hdr -> e_symtab, hdr -> e_symtab);
+    }
+
+    if(!hdr -> e_strtab) {
+        printf("There is no string table present\n");
+    } else {
+        printf("There is a string table starting at offset %" PRIu64 " (0x%02" PRIx64 ")\n",
+               hdr -> e_strtab, hdr -> e_strtab);
+    }
+}
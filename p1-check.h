@@ -3,6 +3,7 @@
 
 #include <getopt.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,6 +20,18 @@
  */
 bool read_header (FILE *file, elf_hdr_t *hdr);
 
+/**
+ * @brief Load a Mini-ELF header of either version from an open file stream
+ *
+ * Version 1 headers are checked by read_header and widened; version 2
+ * headers are read in one piece.
+ *
+ * @param file File stream to use for input
+ * @param hdr Pointer to region where the widened header should be loaded
+ * @returns True if the header was successfully loaded and verified, false otherwise
+ */
+bool read_header2 (FILE *file, elf_hdr2_t *hdr);
+
 /**
  * @brief Print Mini-ELF header information to standard out
  *
@@ -26,4 +39,11 @@ bool read_header (FILE *file, elf_hdr_t *hdr);
  */
 void dump_header (elf_hdr_t *hdr);
 
+/**
+ * @brief Print Mini-ELF version 2 header information to standard out
+ *
+ * @param hdr Header with info to print
+ */
+void dump_header2 (elf_hdr2_t *hdr);
+
 #endif
@@ -49,6 +49,25 @@ bool read_phdr (FILE *file, uint16_t offset, elf_phdr_t *phdr)
     return true;
 }
 
+bool read_phdr2 (FILE *file, uint64_t offset, elf_phdr2_t *phdr)
+{
+    if(phdr == NULL || file == NULL) {
+        return false;
+    }
+
+    //version 2 program headers are aligned and need a single read
+    if(fseek(file, offset, SEEK_SET) != 0 || fread(phdr, sizeof(elf_phdr2_t), 1, file) != 1) {
+        printf("Failed to read file\n");
+        return false;
+    }
+
+    if(phdr -> p_vaddr > MEMSIZE || phdr -> magic != 0xDEADBEEF) {
+        printf("Failed to read file\n");
+        return false;
+    }
+    return true;
+}
+
 //Read data from the file into an address space beginning at memory based on the program header phdr.
 //Note that memory should be a pointer to the beginning of the address space,
 //not the actual location where the segment should go (which can be accessed inside load_segment via phdr using offset).
@@ -135,6 +154,26 @@ void dump_phdrs (uint16_t numphdrs, elf_phdr_t *phdrs)
     }
 }
 
+void dump_phdrs2 (uint32_t numphdrs, elf_phdr2_t *phdrs)
+{
+    printf(" Segment   Offset              Size                VirtAddr  Type      Flags\n");
+    for(uint32_t i = 0; i < numphdrs; i++) {
+        printf("  %02x       0x%016" PRIx64 "  0x%016" PRIx64 "  0x%04" PRIx64 "    ", i,
+               phdrs[i].p_offset, phdrs[i].p_size, phdrs[i].p_vaddr);
+
+        if(phdrs[i].p_type == CODE) {
+            printf("CODE      ");
+        } else if(phdrs[i].p_type == DATA) {
+            printf("DATA      ");
+        } else {
+            printf("STACK     ");
+        }
+
+        printf("%c%c%c\n", (phdrs[i].p_flags & 4) ? 'R' : ' ', (phdrs[i].p_flags & 2) ? 'W' : ' ',
+               (phdrs[i].p_flags & 1) ? 'X' : ' ');
+    }
+}
+
 //Print the contents of Y86 virtual memory starting at address start and ending just before address end.
 //For instance, if start = 5 and end = 8, then you will print the bytes at addresses 5, 6, and 7.
 //Each line of output should be 16-byte aligned, but you should only output hex for the actual bytes requested;
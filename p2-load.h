@@ -3,6 +3,7 @@
 
 #include <getopt.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,6 +22,16 @@
  */
 bool read_phdr (FILE *file, uint16_t offset, elf_phdr_t *phdr);
 
+/**
+ * @brief Load a Mini-ELF version 2 program header from an open file stream
+ *
+ * @param file File stream to use for input
+ * @param offset Byte offset in file where the program header is located
+ * @param phdr Pointer to memory where the program header should be loaded
+ * @returns True if the header was successfully loaded and verified, false otherwise
+ */
+bool read_phdr2 (FILE *file, uint64_t offset, elf_phdr2_t *phdr);
+
 /**
  * @brief Load a Mini-ELF program segment from an open file stream
  *
@@ -40,6 +51,14 @@ bool load_segment (FILE *file, byte_t *memory, elf_phdr_t *phdr);
  */
 void dump_phdrs (uint16_t numphdrs, elf_phdr_t *phdrs);
 
+/**
+ * @brief Print Mini-ELF version 2 program header information to standard out
+ *
+ * @param numphdrs Number of program headers to print
+ * @param phdrs Pointer to array of program headers with info to print
+ */
+void dump_phdrs2 (uint32_t numphdrs, elf_phdr2_t *phdrs);
+
 /**
  * @brief Print a portion of a Y86 address space
  *
@@ -5,6 +5,8 @@
  */
 
 #include "p3-disas.h"
+#include "mem.h"
+#include "predecode.h"
 
 /**********************************************************************
  *                         REQUIRED FUNCTIONS
@@ -13,7 +15,8 @@
 y86_inst_t fetch (y86_t *cpu, byte_t *memory)
 {
     y86_inst_t ins;
-    
+    memset(&ins, 0, sizeof(y86_inst_t));
+
     if(cpu == NULL){
         ins.icode = INVALID;
         return ins;
@@ -24,309 +27,67 @@ y86_inst_t fetch (y86_t *cpu, byte_t *memory)
         cpu -> stat = INS;
         return ins;
     }
-    ins.icode = (*(memory + cpu -> pc) & 0xF0) >> 4;
-
-    bool b1 = false;
-    bool rA = false;
-    bool rB = false;
-    bool jxx = false;
-    bool cmovxx = false;
-    bool irmov = false;
-    bool opq = false;
-    bool pushPop = false;
-    bool trap = false;
-
-    //go through and set rA and rB to NOREG if they arent already initilaized
-    switch(ins.icode) {
-        case (HALT):
-            b1 = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            cpu -> stat = HLT;
-            if(cpu -> pc + 1 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = NOREG;
-            ins.rb = NOREG;
-            ins.valP = cpu -> pc + 1;
-            break;
-
-        case (NOP):
-            b1 = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 1 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = NOREG;
-            ins.rb = NOREG;
-            ins.valP = cpu -> pc + 1;
-            break;
-        case (CMOV):
-            cmovxx = true;
-            rA = true;
-            rB = true;
-            ins.ifun.cmov = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 2 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = (*(memory + cpu -> pc + 1) & 0xF0) >> 4;
-            ins.rb = *(memory + cpu -> pc + 1) & 0x0F;
-            ins.valP = cpu -> pc + 2;
-            break;
-
-        case (IRMOVQ):
-            b1 = true;
-            irmov = true;
-            rB = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 10 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = (*(memory + cpu -> pc + 1) & 0xF0) >> 4;
-            ins.rb = *(memory + cpu -> pc + 1) & 0x0F;
-            memcpy(&(ins.valC.v), memory + cpu -> pc + 2, sizeof(int64_t));
-            ins.valP = cpu -> pc + 10;
-            break;
-
-        case (RMMOVQ):
-            b1 = true;
-            rA = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 10 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = (*(memory + cpu -> pc + 1) & 0xF0) >> 4;
-            ins.rb = *(memory + cpu -> pc + 1) & 0x0F;
-            memcpy(&(ins.valC.d), memory + cpu -> pc + 2, sizeof(int64_t));
-            ins.valP = cpu -> pc + 10;
-            break;
-
-        case (MRMOVQ):
-            b1 = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 10 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = (*(memory + cpu -> pc + 1) & 0xF0) >> 4;
-            ins.rb = *(memory + cpu -> pc + 1) & 0x0F;
-            memcpy(&(ins.valC.d), memory + cpu -> pc + 2, sizeof(int64_t));
-            ins.valP = cpu -> pc + 10;
-            break;
-
-        case (OPQ):
-            opq = true;
-            rA = true;
-            rB = true;
-            ins.ifun.op = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 10 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = (*(memory + cpu -> pc + 1) & 0xF0) >> 4;
-            ins.rb = *(memory + cpu -> pc + 1) & 0x0F;
-            ins.valP = cpu -> pc + 2;
-            break;
-
-        case (JUMP):
-            jxx = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 9 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = NOREG;
-            ins.rb = NOREG;
-            memcpy(&(ins.valC.dest), memory + cpu -> pc + 1, sizeof(int64_t));
-            ins.valP = cpu -> pc + 9;
-            break;
-
-        case (CALL):
-            b1 = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 9 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = NOREG;
-            ins.rb = NOREG;
-            memcpy(&(ins.valC.dest), memory + cpu -> pc + 1, sizeof(int64_t));
-            ins.valP = cpu -> pc + 9;
-            break;
-
-        case (RET):
-            b1 = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 1 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = NOREG;
-            ins.rb = NOREG;
-            ins.valP = cpu -> pc + 1;
-            break;
-
-        case (PUSHQ):
-            b1 = true;
-            rA = true;
-            pushPop = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 1 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = (*(memory + cpu -> pc + 1) & 0xF0) >> 4;
-            ins.rb = *(memory + cpu -> pc + 1) & 0x0F;
-            ins.valP = cpu -> pc + 2;
-            break;
 
-        case (POPQ):
-            b1 = true;
-            rA = true;
-            pushPop = true;
-            ins.ifun.b = *(memory + cpu -> pc) & 0x0F;
-            if(cpu -> pc + 2 > MEMSIZE) {
-                ins.ifun.b = ins.icode;
-                ins.icode = INVALID;
-                cpu -> stat = ADR;
-                return ins;
-            }
-            ins.ra = (*(memory + cpu -> pc + 1) & 0xF0) >> 4;
-            ins.rb = *(memory + cpu -> pc + 1) & 0x0F;
-            ins.valP = cpu -> pc + 2;
-            break;
-
-        case (IOTRAP):
-            trap = true;
-            ins.ifun.trap = *(memory + cpu -> pc) & 0x0F;
-            ins.ra = NOREG;
-            ins.rb = NOREG;
-            ins.valP = cpu -> pc + 1;
-            break;
-
-        default:
-            ins.ifun.b = ins.icode;
-            ins.ra = NOREG;
-            ins.rb = NOREG;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-    }
-
-    //check validity of single byte instruction
-    if(b1) {
-        if(ins.ifun.b != 0) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
-    }
-
-    //check the rA field
-    if(rA) {
-        if(ins.ra > 14 || ins.ra < 0) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
-    }
-
-    //check the rB field
-    if(rB) {
-        if(ins.rb > 14 || ins.rb < 0) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
+    //nothing lies past the end of memory, and the opcode must be executable
+    address_t pc = cpu -> pc;
+    if(pc >= MEMSIZE || !mem_allowed(pc, 1, PG_X)) {
+        ins.icode = INVALID;
+        cpu -> stat = ADR;
+        return ins;
     }
 
-    //check the cmov ifun
-    if(cmovxx) {
-        if(ins.ifun.cmov < 0 || ins.ifun.cmov > 6) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
+    //instructions are at most ten bytes long
+    mem_touch(pc, 10);
+    byte_t opcode = memory[pc];
+    const opdesc_t *op = &y86_opcodes[opcode];
+    ins.icode = opcode >> 4;
+    ins.ifun.b = opcode & 0x0F;
+
+    //unknown icode
+    if(!(op -> flags & OP_KNOWN)) {
+        ins.ifun.b = ins.icode;
+        ins.ra = NOREG;
+        ins.rb = NOREG;
+        ins.icode = INVALID;
+        cpu -> stat = INS;
+        return ins;
     }
 
-    //check opq ifun
-    if(irmov) {
-        if(ins.ra < 15) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
+    if(ins.icode == HALT) {
+        cpu -> stat = HLT;
     }
 
-    //check the opq ifun
-    if(opq) {
-        if(ins.ifun.op < 0 || ins.ifun.op > 3) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
+    //instruction runs off the end of memory or of executable memory
+    if(pc + op -> need > MEMSIZE || !mem_allowed(pc, op -> len, PG_X)) {
+        ins.ifun.b = ins.icode;
+        ins.icode = INVALID;
+        cpu -> stat = ADR;
+        return ins;
     }
 
-    //check the jump ifun
-    if(jxx) {
-        if(ins.ifun.op < 0 || ins.ifun.op > 6) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
+    //register byte (read as zero if pushq sits on the last byte of memory)
+    ins.ra = NOREG;
+    ins.rb = NOREG;
+    if(op -> flags & OP_REGS) {
+        byte_t regs = pc + 1 < MEMSIZE ? memory[pc + 1] : 0;
+        ins.ra = (regs & 0xF0) >> 4;
+        ins.rb = regs & 0x0F;
     }
-
-    //check the push/pop register
-    if(pushPop) {
-        if(ins.rb < 15) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
+    if(op -> valC) {
+        memcpy(&(ins.valC), memory + pc + op -> valC, sizeof(int64_t));
     }
-
-    //check the trap ifun
-    if(trap) {
-        if(ins.ifun.trap < 0 || ins.ifun.trap > 5) {
-            ins.ifun.b = ins.icode;
-            ins.icode = INVALID;
-            cpu -> stat = INS;
-            return ins;
-        }
+    ins.valP = pc + op -> len;
+
+    //check ifun and register fields
+    if(!(op -> flags & OP_VALID) ||
+            ((op -> flags & OP_RA) && ins.ra == NOREG) ||
+            ((op -> flags & OP_RB) && ins.rb == NOREG) ||
+            ((op -> flags & OP_NORA) && ins.ra != NOREG) ||
+            ((op -> flags & OP_NORB) && ins.rb != NOREG)) {
+        ins.ifun.b = ins.icode;
+        ins.icode = INVALID;
+        cpu -> stat = INS;
+        return ins;
     }
     return ins;
 }
@@ -649,27 +410,23 @@ void disassemble_code (byte_t *memory, elf_phdr_t *phdr, elf_hdr_t *hdr)
     if(memory == NULL || phdr == NULL || hdr == NULL) {
         return;
     }
-    y86_t cpu;          // CPU struct to store "fake" PC
-    y86_inst_t ins;     // struct to hold fetched instruction
+    y86_soa_t soa;      // whole segment, decoded up front
+    y86_inst_t ins;     // struct to hold the current instruction
     int currentAddr = phdr -> p_vaddr;
 
-    // start at beginning of the segment
-    cpu.pc = phdr->p_vaddr;
+    if(!predecode_segment(memory, phdr, &soa)) {
+        return;
+    }
 
     printf("  0x%03x:                               | .pos 0x%03x code\n", currentAddr, currentAddr);
 
     // iterate through the segment one instruction at a time
-    while (cpu.pc < phdr -> p_vaddr + phdr -> p_size) {
+    for(uint32_t i = 0; i < soa.count; i++) {
         int currentBits = 0;
         if(currentAddr == hdr -> e_entry) {
             printf("  0x%03x:                               | _start:\n", currentAddr);
         }
-        ins = fetch (&cpu, memory);         // stage 1: fetch instruction
-        if(ins.icode == INVALID) {
-            printf("Invalid opcode: 0x%x%x\n\n", ins.ifun.b, INVALID);
-            return;
-        }
-
+        ins = predecode_inst(&soa, i);
 
         //printing bytes for current instruction
         printf("  0x%03x: ", currentAddr);
@@ -690,10 +447,20 @@ void disassemble_code (byte_t *memory, elf_phdr_t *phdr, elf_hdr_t *hdr)
         printf("|   ");
 
         //print instruction
-        disassemble (&ins);                   // stage 2: print disassembly
+        disassemble (&ins);
         printf("\n");
-        cpu.pc = ins.valP;                    // stage 3: update PC (go to next instruction)
     }
+
+    //the walk stopped at an invalid instruction
+    if(soa.invalid) {
+        if(currentAddr == hdr -> e_entry) {
+            printf("  0x%03x:                               | _start:\n", currentAddr);
+        }
+        printf("Invalid opcode: 0x%x%x\n\n", soa.stopOp >> 4, INVALID);
+        free_soa(&soa);
+        return;
+    }
+    free_soa(&soa);
     printf("\n");
 }
 
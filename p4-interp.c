@@ -5,6 +5,8 @@
  */
 
 #include "p4-interp.h"
+#include "mem.h"
+#include "io.h"
 
 /**********************************************************************
  *                         REQUIRED FUNCTIONS
@@ -315,11 +317,11 @@ void memory_wb_pc (y86_t *cpu, y86_inst_t *inst, byte_t *memory,
         return;
     }
 
-    //static ensures values do not get overwritten, much like global variables
-    //variables for the output buffer and a counter for variables in the buffer
-    static char output[101] = {'\0'};
-    static size_t bufLen = 0;
+    //the output buffer and its character count belong to the program's I/O
+    y86_io_t *io = io_current;
+    char *output = io -> output;
     y86_reg_t memVal = 0;
+    int64_t decVal = 0;
 
     switch(inst -> icode) {
         case (HALT):
@@ -343,8 +345,10 @@ void memory_wb_pc (y86_t *cpu, y86_inst_t *inst, byte_t *memory,
             break;
 
         case (RMMOVQ):
-            if(valE + 8 <= memsize) {
+            if(valE <= memsize - 8 && mem_allowed(valE, 8, PG_W)) {
+                mem_touch(valE, 8);
                 memcpy(memory + valE, &valA, sizeof(y86_reg_t));
+                mem_store(valE, 8);
             } else {
                 cpu -> stat = ADR;
             }
@@ -352,7 +356,8 @@ void memory_wb_pc (y86_t *cpu, y86_inst_t *inst, byte_t *memory,
             break;
 
         case (MRMOVQ):
-            if(valE + 8 <= memsize) {
+            if(valE <= memsize - 8 && mem_allowed(valE, 8, PG_R)) {
+                mem_touch(valE, 8);
                 memcpy(&valM, memory + valE, sizeof(y86_reg_t));
                 cpu -> reg[inst -> ra] = valM;
             } else {
@@ -376,26 +381,50 @@ void memory_wb_pc (y86_t *cpu, y86_inst_t *inst, byte_t *memory,
 
         case (CALL):
             //early check for invalid stack calls
+            if(cpu -> stat != ADR && (valE > memsize - 8 || !mem_allowed(valE, 8, PG_W))) {
+                cpu -> stat = ADR;
+            }
             if(cpu -> stat != ADR) {
+                mem_touch(valE, 8);
                 memcpy(memory + valE, &(inst -> valP), sizeof(y86_reg_t));
+                mem_store(valE, 8);
                 cpu -> reg[RSP] = valE;
             }
             cpu -> pc = (inst -> valC).dest;
             break;
 
         case (RET):
+            if(valA > memsize - 8 || !mem_allowed(valA, 8, PG_R)) {
+                cpu -> stat = ADR;
+                cpu -> pc = inst -> valP;
+                break;
+            }
+            mem_touch(valA, 8);
             memcpy(&valM, memory + valA, sizeof(y86_reg_t));
             cpu -> reg[RSP] = valE;
             cpu -> pc = valM;
             break;
 
         case (PUSHQ):
+            if(valE > memsize - 8 || !mem_allowed(valE, 8, PG_W)) {
+                cpu -> stat = ADR;
+                cpu -> pc = inst -> valP;
+                break;
+            }
+            mem_touch(valE, 8);
             memcpy(memory + valE, &valA, sizeof(y86_reg_t));
+            mem_store(valE, 8);
             cpu -> reg[RSP] = valE;
             cpu -> pc = inst -> valP;
             break;
 
         case (POPQ):
+            if(valA > memsize - 8 || !mem_allowed(valA, 8, PG_R)) {
+                cpu -> stat = ADR;
+                cpu -> pc = inst -> valP;
+                break;
+            }
+            mem_touch(valA, 8);
             memcpy(&valM, memory + valA, sizeof(y86_reg_t));
             cpu -> reg[RSP] = valE;
             cpu -> reg[inst -> ra] = valM;
@@ -405,73 +434,105 @@ void memory_wb_pc (y86_t *cpu, y86_inst_t *inst, byte_t *memory,
         case (IOTRAP):
             switch((inst -> ifun).trap) {
                 case(CHAROUT):
-                    if(!cpu -> reg[RSI] || bufLen >= sizeof(output)) {
+                    if(!cpu -> reg[RSI] || io -> bufLen >= IO_BUFSIZE) {
                         cpu -> stat = HLT;
-                        printf("I/O Error\n");
+                        io_write(io, "I/O Error\n");
+                    } else if(cpu -> reg[RSI] >= memsize || !mem_allowed(cpu -> reg[RSI], 1, PG_R)) {
+                        cpu -> stat = ADR;
                     } else {
                         memVal = cpu -> reg[RSI];
-                        snprintf(&output[bufLen], sizeof(char) * 2, "%c", memory[memVal]);
-                        bufLen ++;
+                        mem_touch(memVal, 1);
+                        snprintf(&output[io -> bufLen], sizeof(char) * 2, "%c", memory[memVal]);
+                        io -> bufLen ++;
                     }
                     cpu -> pc = inst -> valP;
                     break;
 
                 case(CHARIN):
                     memVal = cpu -> reg[RDI];
-                    if(scanf("%c", &memory[memVal]) != 1) {
+                    mem_touch(memVal, 1);
+                    if(memVal >= memsize || !mem_allowed(memVal, 1, PG_W)) {
+                        cpu -> stat = ADR;
+                    } else if(!io_read_char(io, (char*)&memory[memVal])) {
+                        //input still to come: the trap runs again once it has
+                        if(io -> blocked) {
+                            break;
+                        }
                         cpu -> stat = HLT;
-                        printf("I/O Error\n");
+                        io_write(io, "I/O Error\n");
+                    } else {
+                        mem_store(memVal, 1);
                     }
                     cpu -> pc = inst -> valP;
                     break;
 
                 case(DECOUT):
-                    if(!cpu -> reg[RSI] || bufLen > sizeof(output)) {
+                    if(!cpu -> reg[RSI] || io -> bufLen > IO_BUFSIZE) {
                         cpu -> stat = HLT;
-                        printf("I/O Error\n");
+                        io_write(io, "I/O Error\n");
+                    } else if(cpu -> reg[RSI] > memsize - 8 || !mem_allowed(cpu -> reg[RSI], 8, PG_R)) {
+                        cpu -> stat = ADR;
                     } else {
                         memVal = cpu -> reg[RSI];
+                        mem_touch(memVal, 8);
                         //read a byte pointer from memory and typecast it to a 64 bit int pointer
                         int64_t* num = (int64_t*)&memory[memVal];
                         //write the value of the int pointer to output buffer
-                        int numChars = snprintf(&output[bufLen],sizeof(output) - bufLen, "%lld", *num);
-                        //update character count
-                        bufLen += numChars;
+                        int numChars = snprintf(&output[io -> bufLen], IO_BUFSIZE - io -> bufLen, "%" PRId64, *num);
+                        //update character count (digits that did not fit are dropped)
+                        io -> bufLen += numChars;
                     }
                     cpu -> pc = inst -> valP;
                     break;
 
                 case(DECIN):
                     memVal = cpu -> reg[RDI];
-                    if(scanf("%lld", (int64_t*)(&memory[memVal])) != 1) {
+                    mem_touch(memVal, 8);
+                    if(memVal > memsize - 8 || !mem_allowed(memVal, 8, PG_W)) {
+                        cpu -> stat = ADR;
+                    } else if(!io_read_dec(io, &decVal)) {
+                        if(io -> blocked) {
+                            break;
+                        }
                         cpu -> stat = HLT;
-                        printf("I/O Error\n");
+                        io_write(io, "I/O Error\n");
+                    } else {
+                        memcpy(&memory[memVal], &decVal, sizeof(int64_t));
+                        mem_store(memVal, 8);
                     }
                     cpu -> pc = inst -> valP;
                     break;
 
                 case(STROUT):
-                    if(!cpu -> reg[RSI] || bufLen > sizeof(output)) {
+                    if(!cpu -> reg[RSI] || io -> bufLen > IO_BUFSIZE) {
                         cpu -> stat = HLT;
-                        printf("I/O Error\n");
+                        io_write(io, "I/O Error\n");
                     } else {
                         memVal = cpu -> reg[RSI];
 
-                        //loop through chars adding them to output buffer until null pointer is reached
-                        char cur = memory[memVal];
+                        //loop through chars adding them to output buffer until null pointer is reached;
+                        //the end of memory stops the string, and characters that do not fit are dropped
+                        mem_touch(memVal, 1);
+                        char cur = memVal < memsize && mem_allowed(memVal, 1, PG_R) ? memory[memVal] : '\0';
                         while(cur != '\0') {
-                            snprintf(&output[bufLen], sizeof(output) - bufLen, "%c", cur);
-                            cur = memory[++memVal];
-                            bufLen++;
+                            if(io -> bufLen < IO_BUFSIZE) {
+                                snprintf(&output[io -> bufLen], IO_BUFSIZE - io -> bufLen, "%c", cur);
+                            }
+                            mem_touch(++memVal, 1);
+                            cur = memVal < memsize && mem_allowed(memVal, 1, PG_R) ? memory[memVal] : '\0';
+                            io -> bufLen++;
+                        }
+                        if(memVal >= memsize || !mem_allowed(memVal, 1, PG_R)) {
+                            cpu -> stat = ADR;
                         }
                     }
                     cpu -> pc = inst -> valP;
                     break;
 
                 case(FLUSH):
-                    output[bufLen] = '\0';
-                    printf("%s", output);
-                    memset(output, '\0', sizeof(output));
+                    output[io -> bufLen < IO_BUFSIZE ? io -> bufLen : IO_BUFSIZE] = '\0';
+                    io_write(io, output);
+                    memset(output, '\0', sizeof(io -> output));
                     cpu -> pc = inst -> valP;
                     break;
 
@@ -0,0 +1,135 @@
+/*
+ * Cycle-approximate PIPE timing model
+ *
+ * Name: Griffin Moran
+ */
+
+#include "pipe.h"
+
+/*
+Find the registers an instruction reads in the decode stage (srcA and srcB).
+Unused slots are set to NOREG.
+*/
+static void pipe_sources (y86_inst_t *inst, y86_regnum_t *srcA, y86_regnum_t *srcB)
+{
+    *srcA = NOREG;
+    *srcB = NOREG;
+
+    switch(inst -> icode) {
+        case (CMOV):
+            *srcA = inst -> ra;
+            break;
+
+        case (RMMOVQ):
+        case (OPQ):
+            *srcA = inst -> ra;
+            *srcB = inst -> rb;
+            break;
+
+        case (MRMOVQ):
+            *srcB = inst -> rb;
+            break;
+
+        case (CALL):
+            *srcB = RSP;
+            break;
+
+        case (RET):
+        case (POPQ):
+            *srcA = RSP;
+            *srcB = RSP;
+            break;
+
+        case (PUSHQ):
+            *srcA = inst -> ra;
+            *srcB = RSP;
+            break;
+
+        case (IOTRAP):
+            //traps take their buffer address from %rsi (output) or %rdi (input)
+            if((inst -> ifun).trap == CHARIN || (inst -> ifun).trap == DECIN) {
+                *srcA = RDI;
+            } else {
+                *srcA = RSI;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void pipe_init (pipe_t *pp, bpred_t *bp)
+{
+    if(pp == NULL) {
+        return;
+    }
+    memset(pp, 0, sizeof(pipe_t));
+    pp -> dstM = NOREG;
+    pp -> bp = bp;
+}
+
+void pipe_retire (pipe_t *pp, address_t pc, y86_inst_t *inst, bool cnd, address_t next)
+{
+    if(pp == NULL || inst == NULL) {
+        return;
+    }
+
+    y86_regnum_t srcA;
+    y86_regnum_t srcB;
+    bool miss = false;
+
+    pp -> insns++;
+
+    //load/use: a value loaded by the previous instruction cannot be forwarded
+    //in time for decode, so one bubble is inserted
+    pipe_sources(inst, &srcA, &srcB);
+    if(pp -> dstM != NOREG && (srcA == pp -> dstM || srcB == pp -> dstM)) {
+        pp -> loadUse++;
+    }
+
+    //everything else is covered by forwarding
+    if(inst -> icode == MRMOVQ || inst -> icode == POPQ) {
+        pp -> dstM = inst -> ra;
+    } else {
+        pp -> dstM = NOREG;
+    }
+
+    if(pp -> bp != NULL) {
+        miss = bpred_update(pp -> bp, pc, inst, cnd, next);
+    } else if(inst -> icode == JUMP) {
+        //PIPE always predicts taken
+        miss = !cnd;
+    } else if(inst -> icode == RET) {
+        miss = true;
+    }
+
+    //a wrong jump is caught in execute (two bubbles), a ret in write-back
+    //once the return address has been read from memory (three bubbles)
+    if(miss && inst -> icode == JUMP) {
+        pp -> mispredict += 2;
+    } else if(miss && inst -> icode == RET) {
+        pp -> ret += 3;
+    }
+}
+
+void pipe_dump (pipe_t *pp)
+{
+    if(pp == NULL) {
+        return;
+    }
+
+    uint64_t bubbles = pp -> loadUse + pp -> mispredict + pp -> ret;
+    uint64_t cycles = 0;
+
+    //the first instruction needs the whole pipeline to fill
+    if(pp -> insns > 0) {
+        cycles = pp -> insns + (PIPE_STAGES - 1) + bubbles;
+    }
+
+    printf("Pipeline cycles: %" PRIu64 " (CPI %.2f)\n", cycles,
+           pp -> insns ? (double)(pp -> insns + bubbles) / pp -> insns : 0.0);
+    printf("  load/use bubbles:    %" PRIu64 "\n", pp -> loadUse);
+    printf("  mispredict bubbles:  %" PRIu64 "\n", pp -> mispredict);
+    printf("  ret bubbles:         %" PRIu64 "\n", pp -> ret);
+}
@@ -0,0 +1,56 @@
+#ifndef __CS261_PIPE__
+#define __CS261_PIPE__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+#include "bpred.h"
+
+#define PIPE_STAGES 5
+
+/* timing state of the five-stage PIPE model */
+typedef struct pipe {
+
+    uint64_t insns;             // retired instructions
+    uint64_t loadUse;           // bubbles inserted for load/use hazards
+    uint64_t mispredict;        // bubbles inserted for mispredicted jumps
+    uint64_t ret;               // bubbles inserted while waiting on ret
+
+    y86_regnum_t dstM;          // register loaded by the previous instruction
+
+    bpred_t *bp;                // optional predictor replacing predict-taken
+
+} pipe_t;
+
+/**
+ * @brief Reset the pipeline model
+ *
+ * @param pp Pointer to the pipeline model
+ * @param bp Branch predictor used for jumps and returns, or NULL for the
+ * classic PIPE policy (predict taken, always stall on ret)
+ */
+void pipe_init (pipe_t *pp, bpred_t *bp);
+
+/**
+ * @brief Account for the timing of an instruction retired by the functional engine
+ *
+ * @param pp Pointer to the pipeline model
+ * @param pc Address of the retired instruction
+ * @param inst Retired Y86 instruction
+ * @param cnd Condition computed by decode_execute
+ * @param next Address of the instruction executed next
+ */
+void pipe_retire (pipe_t *pp, address_t pc, y86_inst_t *inst, bool cnd, address_t next);
+
+/**
+ * @brief Print cycle count, CPI and stall breakdown to standard out
+ *
+ * @param pp Pointer to the pipeline model
+ */
+void pipe_dump (pipe_t *pp);
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Whole-segment instruction pre-decoder
+ *
+ * Name: Griffin Moran
+ */
+
+#include "predecode.h"
+#include "mem.h"
+
+/*
+One row of the table covers the sixteen ifun values of an icode; ifun values
+below n are valid. The bounds checks keep the lengths the original decoder
+tested, which differ from the instruction length for OPq and pushq.
+*/
+#define OPD(len, need, valC, flags, n, f) \
+    { len, need, valC, (flags) | OP_KNOWN | ((f) < (n) ? OP_VALID : 0) }
+#define OPROW(len, need, valC, flags, n) \
+    OPD(len, need, valC, flags, n, 0),  OPD(len, need, valC, flags, n, 1),  \
+    OPD(len, need, valC, flags, n, 2),  OPD(len, need, valC, flags, n, 3),  \
+    OPD(len, need, valC, flags, n, 4),  OPD(len, need, valC, flags, n, 5),  \
+    OPD(len, need, valC, flags, n, 6),  OPD(len, need, valC, flags, n, 7),  \
+    OPD(len, need, valC, flags, n, 8),  OPD(len, need, valC, flags, n, 9),  \
+    OPD(len, need, valC, flags, n, 10), OPD(len, need, valC, flags, n, 11), \
+    OPD(len, need, valC, flags, n, 12), OPD(len, need, valC, flags, n, 13), \
+    OPD(len, need, valC, flags, n, 14), OPD(len, need, valC, flags, n, 15)
+#define BADROW \
+    {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, \
+    {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, \
+    {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, \
+    {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}
+
+const opdesc_t y86_opcodes[256] = {
+    OPROW(1,  1, 0, 0, 1),                                  // halt
+    OPROW(1,  1, 0, 0, 1),                                  // nop
+    OPROW(2,  2, 0, OP_REGS | OP_RA | OP_RB, 7),            // cmovXX
+    OPROW(10, 10, 2, OP_REGS | OP_RB | OP_NORA, 1),         // irmovq
+    OPROW(10, 10, 2, OP_REGS | OP_RA, 1),                   // rmmovq
+    OPROW(10, 10, 2, OP_REGS, 1),                           // mrmovq
+    OPROW(2,  10, 0, OP_REGS | OP_RA | OP_RB, 4),           // OPq
+    OPROW(9,  9, 1, 0, 7),                                  // jXX
+    OPROW(9,  9, 1, 0, 1),                                  // call
+    OPROW(1,  1, 0, 0, 1),                                  // ret
+    OPROW(2,  1, 0, OP_REGS | OP_RA | OP_NORB, 1),          // pushq
+    OPROW(2,  2, 0, OP_REGS | OP_RA | OP_NORB, 1),          // popq
+    OPROW(1,  1, 0, 0, 6),                                  // iotrap
+    BADROW,
+    BADROW,
+    BADROW
+};
+
+/*
+Length of the instruction starting at addr, or 0 if fetch would reject it.
+Small enough to inline so the classification loop is a tight pass over the
+segment with one table lookup per byte.
+*/
+static inline uint8_t predecode_len (byte_t *memory, address_t addr)
+{
+    const opdesc_t *op = &y86_opcodes[memory[addr]];
+    byte_t regs = addr + 1 < MEMSIZE ? memory[addr + 1] : 0;
+    uint8_t ra = regs >> 4;
+    uint8_t rb = regs & 0x0F;
+    uint8_t f = op -> flags;
+
+    bool ok = (f & OP_KNOWN) && (f & OP_VALID) && addr + op -> need <= MEMSIZE;
+    ok = ok && !((f & OP_RA) && ra == NOREG) && !((f & OP_RB) && rb == NOREG);
+    ok = ok && !((f & OP_NORA) && ra != NOREG) && !((f & OP_NORB) && rb != NOREG);
+    return ok ? op -> len : 0;
+}
+
+bool predecode_segment (byte_t *memory, elf_phdr_t *phdr, y86_soa_t *soa)
+{
+    if(memory == NULL || phdr == NULL || soa == NULL) {
+        return false;
+    }
+    memset(soa, 0, sizeof(y86_soa_t));
+
+    address_t start = phdr -> p_vaddr;
+    address_t end = (address_t)phdr -> p_vaddr + phdr -> p_size;
+    if(end > MEMSIZE) {
+        end = MEMSIZE;
+    }
+    if(start >= end) {
+        return true;
+    }
+    uint32_t n = end - start;
+
+    //the last instruction may run up to nine bytes past the segment
+    mem_touch(start, n + 9);
+
+    //every instruction is at least one byte long
+    uint8_t *len = (uint8_t*)malloc(n);
+    soa -> pc = (address_t*)malloc(n * sizeof(address_t));
+    soa -> op = (byte_t*)malloc(n);
+    soa -> regs = (byte_t*)malloc(n);
+    soa -> valC = (int64_t*)malloc(n * sizeof(int64_t));
+    soa -> valP = (address_t*)malloc(n * sizeof(address_t));
+    if(len == NULL || soa -> pc == NULL || soa -> op == NULL || soa -> regs == NULL ||
+            soa -> valC == NULL || soa -> valP == NULL) {
+        free(len);
+        free_soa(soa);
+        return false;
+    }
+
+    //classify every byte of the segment
+    for(uint32_t i = 0; i < n; i++) {
+        len[i] = predecode_len(memory, start + i);
+    }
+
+    //follow the lengths from the start of the segment
+    uint32_t i = 0;
+    uint32_t count = 0;
+    while(i < n && len[i] != 0) {
+        soa -> pc[count++] = start + i;
+        i += len[i];
+    }
+    if(i < n) {
+        soa -> invalid = true;
+        soa -> stop = start + i;
+        soa -> stopOp = memory[start + i];
+    }
+    free(len);
+
+    //gather the fields of the instructions on the chain
+    for(uint32_t k = 0; k < count; k++) {
+        address_t pc = soa -> pc[k];
+        const opdesc_t *op = &y86_opcodes[memory[pc]];
+        soa -> op[k] = memory[pc];
+        soa -> regs[k] = (op -> flags & OP_REGS) ? memory[pc + 1] : 0xFF;
+        soa -> valC[k] = 0;
+        if(op -> valC) {
+            memcpy(&(soa -> valC[k]), memory + pc + op -> valC, sizeof(int64_t));
+        }
+        soa -> valP[k] = pc + op -> len;
+    }
+    soa -> count = count;
+    return true;
+}
+
+y86_inst_t predecode_inst (y86_soa_t *soa, uint32_t i)
+{
+    y86_inst_t ins;
+    memset(&ins, 0, sizeof(y86_inst_t));
+    if(soa == NULL || i >= soa -> count) {
+        ins.icode = INVALID;
+        return ins;
+    }
+
+    ins.icode = soa -> op[i] >> 4;
+    ins.ifun.b = soa -> op[i] & 0x0F;
+    ins.ra = soa -> regs[i] >> 4;
+    ins.rb = soa -> regs[i] & 0x0F;
+    ins.valC.v = soa -> valC[i];
+    ins.valP = soa -> valP[i];
+    return ins;
+}
+
+y86_packed_t pack_inst (y86_inst_t *inst, address_t pc)
+{
+    y86_packed_t packed;
+    memset(&packed, 0, sizeof(y86_packed_t));
+    if(inst == NULL) {
+        return packed;
+    }
+
+    packed.op = (inst -> icode << 4) | (inst -> ifun.b & 0x0F);
+    packed.regs = (inst -> ra << 4) | (inst -> rb & 0x0F);
+    packed.valC = inst -> valC.v;
+    packed.len = inst -> valP - pc;
+    return packed;
+}
+
+y86_inst_t unpack_inst (y86_packed_t *packed, address_t pc)
+{
+    y86_inst_t ins;
+    memset(&ins, 0, sizeof(y86_inst_t));
+    if(packed == NULL) {
+        ins.icode = INVALID;
+        return ins;
+    }
+
+    ins.icode = packed -> op >> 4;
+    ins.ifun.b = packed -> op & 0x0F;
+    ins.ra = packed -> regs >> 4;
+    ins.rb = packed -> regs & 0x0F;
+    ins.valC.v = packed -> valC;
+    ins.valP = pc + packed -> len;
+    return ins;
+}
+
+void free_soa (y86_soa_t *soa)
+{
+    if(soa == NULL) {
+        return;
+    }
+    free(soa -> pc);
+    free(soa -> op);
+    free(soa -> regs);
+    free(soa -> valC);
+    free(soa -> valP);
+    memset(soa, 0, sizeof(y86_soa_t));
+}
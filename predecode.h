@@ -0,0 +1,124 @@
+#ifndef __CS261_PREDECODE__
+#define __CS261_PREDECODE__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elf.h"
+#include "y86.h"
+
+/* opcode descriptor flags */
+#define OP_KNOWN    0x01        // icode names an instruction
+#define OP_VALID    0x02        // ifun is valid for the icode
+#define OP_REGS     0x04        // a register byte follows the opcode
+#define OP_RA       0x08        // rA must name a register
+#define OP_RB       0x10        // rB must name a register
+#define OP_NORA     0x20        // rA must be NOREG
+#define OP_NORB     0x40        // rB must be NOREG
+
+/* decoding information for one opcode byte */
+typedef struct opdesc {
+    uint8_t len;                // instruction length (valP - pc)
+    uint8_t need;               // bytes that must lie inside memory
+    uint8_t valC;               // offset of valC, or 0 when there is none
+    uint8_t flags;              // OP_* bits
+} opdesc_t;
+
+/* descriptor of every opcode byte, indexed by the byte itself */
+extern const opdesc_t y86_opcodes[256];
+
+/* packed form of a decoded instruction (16 bytes, four per cache line)
+
+   Holds exactly what y86_inst_t carries: the opcode and register bytes as
+   they appear in memory, valC, and valP as a distance from the address of
+   the instruction. Invalid instructions keep icode INVALID and the original
+   icode in the ifun nibble, as fetch returns them, and record the status
+   fetch gives the CPU for them. */
+typedef struct y86_packed {
+
+    int64_t valC;               // constant word, 0 when there is none
+    byte_t op;                  // icode << 4 | ifun
+    byte_t regs;                // ra << 4 | rb
+    uint8_t len;                // valP - pc
+    uint8_t stat;               // ADR or INS if the instruction cannot run,
+                                // 0 once it has been verified
+    uint8_t pad[4];
+
+} y86_packed_t;
+
+/* struct-of-arrays decoding of one code segment
+
+   Instruction i starts at pc[i]; its opcode byte holds icode and ifun and its
+   register byte holds rA and rB (NOREG for both when there is none). Decoding
+   follows the same walk as disassemble_code and stops at the first invalid
+   instruction, whose address and opcode byte are kept in stop and stopOp. */
+typedef struct y86_soa {
+
+    uint32_t count;             // number of decoded instructions
+    address_t *pc;              // address of each instruction
+    byte_t *op;                 // opcode byte (icode << 4 | ifun)
+    byte_t *regs;               // register byte (ra << 4 | rb)
+    int64_t *valC;              // constant word, 0 when there is none
+    address_t *valP;            // address of the next instruction
+
+    bool invalid;               // the walk ended on an invalid instruction
+    address_t stop;             // address of that instruction
+    byte_t stopOp;              // its opcode byte
+
+} y86_soa_t;
+
+/**
+ * @brief Decode a whole code segment into a struct of arrays
+ *
+ * Every byte of the segment is first classified through y86_opcodes in a
+ * single pass that yields the instruction length at that byte, or zero if
+ * an instruction starting there would be INS or ADR. The
+ * instruction boundaries are then found by following the lengths from the
+ * start of the segment, and only the instructions on that chain are
+ * gathered into the arrays.
+ *
+ * @param memory Pointer to the beginning of the Y86 address space
+ * @param phdr Program header of the segment
+ * @param soa Pointer to the arrays to be populated
+ * @returns True if the arrays could be allocated, false otherwise
+ */
+bool predecode_segment (byte_t *memory, elf_phdr_t *phdr, y86_soa_t *soa);
+
+/**
+ * @brief Expand one predecoded instruction into the public structure
+ *
+ * @param soa Predecoded segment
+ * @param i Index of the instruction
+ * @returns The instruction exactly as fetch would return it
+ */
+y86_inst_t predecode_inst (y86_soa_t *soa, uint32_t i);
+
+/**
+ * @brief Pack an instruction returned by fetch
+ *
+ * @param inst Instruction to pack
+ * @param pc Address the instruction was fetched from
+ * @returns Packed instruction
+ */
+y86_packed_t pack_inst (y86_inst_t *inst, address_t pc);
+
+/**
+ * @brief Expand a packed instruction for the public fetch/execute APIs
+ *
+ * @param packed Packed instruction
+ * @param pc Address of the instruction
+ * @returns The instruction exactly as fetch returned it
+ */
+y86_inst_t unpack_inst (y86_packed_t *packed, address_t pc);
+
+/**
+ * @brief Release the arrays of a predecoded segment
+ *
+ * @param soa Predecoded segment
+ */
+void free_soa (y86_soa_t *soa);
+
+#endif
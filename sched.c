@@ -0,0 +1,443 @@
+/*
+ * Many programs served on one thread
+ *
+ * Name: Griffin Moran
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "sched.h"
+
+/* set by SIGINT and SIGTERM while serving */
+static volatile sig_atomic_t schedStop;
+
+static void sched_signal (int sig)
+{
+    (void)sig;
+    schedStop = 1;
+}
+
+/*
+Queue a ready program, at the back or, woken by its connection, in front.
+*/
+static void sched_ready (sched_t *sch, sched_vm_t *vm, bool first)
+{
+    vm -> wait = SCHED_READY;
+    vm -> next = NULL;
+    if(sch -> head == NULL) {
+        sch -> head = vm;
+        sch -> tail = vm;
+    } else if(first) {
+        vm -> next = sch -> head;
+        sch -> head = vm;
+    } else {
+        sch -> tail -> next = vm;
+        sch -> tail = vm;
+    }
+}
+
+/*
+Accept connections again once a descriptor may have been freed.
+*/
+static void sched_resume (sched_t *sch)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if(epoll_ctl(sch -> epollFd, EPOLL_CTL_ADD, sch -> listenFd, &ev) == 0) {
+        sch -> paused = false;
+    }
+}
+
+/*
+Close the connection of a program that is not queued and release it.
+*/
+static void sched_close (sched_t *sch, sched_vm_t *vm)
+{
+    if(vm -> prevLive != NULL) {
+        vm -> prevLive -> nextLive = vm -> nextLive;
+    } else {
+        sch -> all = vm -> nextLive;
+    }
+    if(vm -> nextLive != NULL) {
+        vm -> nextLive -> prevLive = vm -> prevLive;
+    }
+    close(vm -> fd);
+    free(vm);
+    sch -> live--;
+    if(sch -> paused) {
+        sched_resume(sch);
+    }
+}
+
+/*
+Sink of the programs' output: it goes straight to the connection, and what
+the connection does not take stops the program until it has been written.
+A program writes once per instruction at most.
+*/
+static void sched_sink (void *arg, const char *s)
+{
+    sched_t *sch = (sched_t*)arg;
+    sched_vm_t *vm = sch -> cur;
+    size_t len = strlen(s);
+    if(vm == NULL || vm -> gone || len == 0) {
+        return;
+    }
+
+    ssize_t n;
+    do {
+        n = send(vm -> fd, s, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while(n < 0 && errno == EINTR);
+    if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        vm -> gone = true;
+    } else {
+        size_t left = len - (n > 0 ? (size_t)n : 0);
+        if(left > sizeof(vm -> pending) - vm -> pendingLen) {
+            left = sizeof(vm -> pending) - vm -> pendingLen;
+        }
+        memcpy(vm -> pending + vm -> pendingLen, s + len - left, left);
+        vm -> pendingLen += left;
+    }
+
+    if(vm -> gone || vm -> pendingLen > 0) {
+        sch -> eng.limited = ENG_INTERRUPT;
+        sch -> eng.checkAt = 0;
+    }
+}
+
+/*
+Write the output a program left; true once there is none left to write.
+*/
+static bool sched_drain (sched_vm_t *vm)
+{
+    while(vm -> pendingLen > 0 && !vm -> gone) {
+        ssize_t n = send(vm -> fd, vm -> pending, vm -> pendingLen, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(n < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                return false;
+            }
+            if(errno != EINTR) {
+                vm -> gone = true;
+            }
+            continue;
+        }
+        memmove(vm -> pending, vm -> pending + n, vm -> pendingLen - n);
+        vm -> pendingLen -= n;
+    }
+    return true;
+}
+
+/*
+Take what the connection of a program blocked on input has sent; true if the
+program can go on, i.e. something arrived or the input has ended.
+*/
+static bool sched_fill (sched_vm_t *vm)
+{
+    //what the traps have taken is dropped from the front
+    y86_io_t *io = &(vm -> io);
+    size_t left = io -> inputLen - io -> inputPos;
+    memmove(vm -> input, vm -> input + io -> inputPos, left);
+    io -> inputPos = 0;
+    io -> inputLen = left;
+
+    while(true) {
+        byte_t *in = vm -> input + left;
+        ssize_t n = recv(vm -> fd, in, SCHED_INPUT - left, MSG_DONTWAIT);
+        if(n < 0 && errno == EINTR) {
+            continue;
+        }
+        if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            io -> more = false;
+            return true;
+        }
+        if(n < 0) {
+            return false;
+        }
+
+        //the rest of a number too long for the buffer went with it
+        ssize_t skip = 0;
+        while(vm -> digits && skip < n && isdigit(in[skip])) {
+            skip++;
+        }
+        if(skip < n) {
+            vm -> digits = false;
+            memmove(in, in + skip, n - skip);
+            io -> inputLen += n - skip;
+            return true;
+        }
+    }
+}
+
+/*
+Give a program its turn: switch the shared engine, the page table and the
+I/O to it, run it for a quantum, and queue, park or close it depending on
+why it gave the thread back.
+*/
+static void sched_run (sched_t *sch, sched_vm_t *vm)
+{
+    engine_t *eng = &(sch -> eng);
+    eng -> cpu = &(vm -> cpu);
+    eng -> memory = vm -> memory;
+    eng -> count = vm -> count;
+    eng -> rasTop = 0;
+    eng -> predicted = -1;
+    mem_current = &(vm -> mem);
+    io_current = &(vm -> io);
+    sch -> cur = vm;
+
+    uint64_t until = vm -> count + SCHED_QUANTUM;
+    if(sch -> maxInsns != 0 && sch -> maxInsns < until) {
+        until = sch -> maxInsns;
+    }
+    engine_limits(eng, until, 0);
+    engine_run(eng);
+
+    //a number that fills the whole input buffer is taken as it stands
+    if(eng -> limited == ENG_BLOCKED && vm -> io.inputLen - vm -> io.inputPos == SCHED_INPUT) {
+        vm -> io.more = false;
+        engine_resume(eng);
+        engine_step(eng, false);
+        vm -> io.more = true;
+        vm -> digits = true;
+    }
+
+    vm -> count = eng -> count;
+    sch -> cur = NULL;
+    if(vm -> cpu.stat != AOK || (sch -> maxInsns != 0 && vm -> count >= sch -> maxInsns)) {
+        vm -> ended = true;
+    }
+
+    if(vm -> gone || (vm -> ended && vm -> pendingLen == 0)) {
+        sched_close(sch, vm);
+    } else if(vm -> pendingLen > 0) {
+        vm -> wait = SCHED_OUTPUT_WAIT;
+    } else if(eng -> limited == ENG_BLOCKED && !sched_fill(vm)) {
+        vm -> wait = SCHED_INPUT_WAIT;
+    } else {
+        sched_ready(sch, vm, false);
+    }
+}
+
+/*
+Start a copy of the program on every pending connection.
+*/
+static void sched_accept (sched_t *sch)
+{
+    while(true) {
+        int fd = accept(sch -> listenFd, NULL, NULL);
+        if(fd < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            //out of descriptors or memory: wait for a connection to close
+            if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                epoll_ctl(sch -> epollFd, EPOLL_CTL_DEL, sch -> listenFd, NULL);
+                sch -> paused = true;
+            }
+            return;
+        }
+
+        //output is written as the program flushes it; fails harmlessly on
+        //Unix sockets
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        sched_vm_t *vm = (sched_vm_t*)malloc(sizeof(sched_vm_t));
+        if(vm == NULL) {
+            close(fd);
+            continue;
+        }
+        memset(vm, 0, sizeof(sched_vm_t));
+        vm -> cpu = sch -> cpu;
+        vm -> count = sch -> count;
+        memcpy(vm -> memory, sch -> memory, MEMSIZE);
+        vm -> mem = sch -> mem;
+        vm -> mem.memory = vm -> memory;
+        io_init_buffer(&(vm -> io), vm -> input, 0);
+        vm -> io.more = true;
+        vm -> io.sink = sched_sink;
+        vm -> io.sinkArg = sch;
+        vm -> fd = fd;
+
+        //edge-triggered: a program reads until the socket is empty before
+        //it waits, and writes until it is full
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = vm;
+        if(epoll_ctl(sch -> epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(vm);
+            continue;
+        }
+
+        vm -> nextLive = sch -> all;
+        if(sch -> all != NULL) {
+            sch -> all -> prevLive = vm;
+        }
+        sch -> all = vm;
+        sch -> live++;
+        sch -> served++;
+        if(sch -> live > sch -> peak) {
+            sch -> peak = sch -> live;
+        }
+        sched_ready(sch, vm, false);
+    }
+}
+
+/*
+Wake up the program whose connection has something for it.
+*/
+static void sched_event (sched_t *sch, sched_vm_t *vm, uint32_t events)
+{
+    if(vm -> wait == SCHED_INPUT_WAIT && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) &&
+            sched_fill(vm)) {
+        sched_ready(sch, vm, true);
+    } else if(vm -> wait == SCHED_OUTPUT_WAIT && (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) &&
+              sched_drain(vm)) {
+        if(vm -> gone || vm -> ended) {
+            sched_close(sch, vm);
+        } else {
+            sched_ready(sch, vm, true);
+        }
+    }
+}
+
+void sched_init (sched_t *sch, y86_t *cpu, byte_t *memory, y86_decoded_t *prog,
+                 uint64_t count, uint64_t maxInsns)
+{
+    if(sch == NULL) {
+        return;
+    }
+    memset(sch, 0, sizeof(sched_t));
+    sch -> listenFd = -1;
+    sch -> epollFd = -1;
+    if(cpu == NULL || memory == NULL) {
+        return;
+    }
+    sch -> cpu = *cpu;
+    sch -> memory = memory;
+    sch -> count = count;
+    sch -> maxInsns = maxInsns;
+
+    //the engine marks the decoded code in the page table the programs copy,
+    //so a store into code by any of them drops it for all of them
+    engine_init(&(sch -> eng), &(sch -> cpu), memory, prog);
+    if(mem_current != NULL) {
+        sch -> mem = *mem_current;
+    } else {
+        mem_init(&(sch -> mem), memory);
+    }
+}
+
+bool sched_listen (sched_t *sch, const char *where)
+{
+    if(sch == NULL || sch -> memory == NULL) {
+        return false;
+    }
+    sch -> listenFd = io_listen(where, SCHED_BACKLOG, sch -> path, sizeof(sch -> path));
+    if(sch -> listenFd < 0) {
+        return false;
+    }
+    sch -> epollFd = epoll_create1(0);
+    if(sch -> epollFd < 0) {
+        return false;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    int flags = fcntl(sch -> listenFd, F_GETFL);
+    return flags >= 0 && fcntl(sch -> listenFd, F_SETFL, flags | O_NONBLOCK) == 0 &&
+           epoll_ctl(sch -> epollFd, EPOLL_CTL_ADD, sch -> listenFd, &ev) == 0;
+}
+
+void sched_serve (sched_t *sch)
+{
+    if(sch == NULL || sch -> listenFd < 0 || sch -> epollFd < 0) {
+        return;
+    }
+
+    //interrupted waits return, so a signal ends the loop right away
+    struct sigaction sa;
+    struct sigaction oldInt;
+    struct sigaction oldTerm;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sched_signal;
+    sigemptyset(&sa.sa_mask);
+    schedStop = 0;
+    sigaction(SIGINT, &sa, &oldInt);
+    sigaction(SIGTERM, &sa, &oldTerm);
+
+    y86_mem_t *mem = mem_current;
+    y86_io_t *io = io_current;
+    struct epoll_event events[SCHED_EVENTS];
+    while(!schedStop) {
+        if(sch -> head != NULL) {
+            sched_vm_t *vm = sch -> head;
+            sch -> head = vm -> next;
+            if(sch -> head == NULL) {
+                sch -> tail = NULL;
+            }
+            sched_run(sch, vm);
+        }
+        if(sch -> paused) {
+            sched_resume(sch);
+        }
+
+        //only sleep when no program is ready (or, out of descriptors, for
+        //a second before accepting again)
+        int n = epoll_wait(sch -> epollFd, events, SCHED_EVENTS,
+                           sch -> head != NULL ? 0 : sch -> paused ? 1000 : -1);
+        for(int i = 0; i < n; i++) {
+            if(events[i].data.ptr == NULL) {
+                sched_accept(sch);
+            } else {
+                sched_event(sch, (sched_vm_t*)events[i].data.ptr, events[i].events);
+            }
+        }
+    }
+
+    mem_current = mem;
+    io_current = io;
+    sigaction(SIGINT, &oldInt, NULL);
+    sigaction(SIGTERM, &oldTerm, NULL);
+}
+
+void sched_free (sched_t *sch)
+{
+    if(sch == NULL) {
+        return;
+    }
+    sch -> head = NULL;
+    sch -> tail = NULL;
+    sch -> paused = false;
+    while(sch -> all != NULL) {
+        sched_close(sch, sch -> all);
+    }
+    if(sch -> epollFd >= 0) {
+        close(sch -> epollFd);
+        sch -> epollFd = -1;
+    }
+    if(sch -> listenFd >= 0) {
+        close(sch -> listenFd);
+        sch -> listenFd = -1;
+    }
+    if(sch -> path[0] != '\0') {
+        unlink(sch -> path);
+        sch -> path[0] = '\0';
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef __CS261_SCHED__
+#define __CS261_SCHED__
+
+#include <stdbool.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "y86.h"
+#include "engine.h"
+#include "mem.h"
+#include "io.h"
+
+/* instructions a program runs before the next ready one gets its turn */
+#define SCHED_QUANTUM ENGINE_QUANTUM
+
+/* input bytes a program holds before its traps take them */
+#define SCHED_INPUT 64
+
+/* connections waiting to be accepted */
+#define SCHED_BACKLOG 1024
+
+/* events taken from epoll at once */
+#define SCHED_EVENTS 256
+
+/* what a served program is waiting for */
+typedef enum {
+    SCHED_READY = 0, SCHED_INPUT_WAIT, SCHED_OUTPUT_WAIT
+} sched_wait_t;
+
+/* one program served on one connection
+
+   Every program is a stackless coroutine: all it needs to go on is kept
+   here, so it gives up the thread by returning from the engine (at the end
+   of its quantum, or before an input trap whose input has not arrived) and
+   goes on where it left off by being run again. Besides the CPU, its pages
+   and the trap buffers, a program owns nothing; the engine and the decoded
+   program are shared by all of them. */
+typedef struct sched_vm {
+
+    y86_t cpu;                  // CPU state
+    uint64_t count;             // retired instructions
+    byte_t memory[MEMSIZE];     // Y86 address space
+    y86_mem_t mem;              // its page table
+
+    y86_io_t io;                // trap I/O, buffered on input
+    byte_t input[SCHED_INPUT];  // input received and not yet taken
+    char pending[IO_BUFSIZE + 1];   // output the connection has not taken
+    uint32_t pendingLen;
+    bool digits;                // digits still to come belong to a number
+                                // taken when it filled the input buffer
+
+    int fd;                     // connection
+    sched_wait_t wait;          // what the program waits for
+    bool ended;                 // the program stopped (close once written)
+    bool gone;                  // the connection failed (close right away)
+
+    struct sched_vm *next;      // next ready program
+    struct sched_vm *prevLive;  // neighbours among all programs served
+    struct sched_vm *nextLive;
+
+} sched_vm_t;
+
+/* runs the programs served on every connection to a socket on one thread */
+typedef struct sched {
+
+    int listenFd;               // listening socket, or -1
+    int epollFd;                // epoll instance, or -1
+    char path[108];             // Unix socket file to remove, or ""
+    bool paused;                // out of descriptors: not accepting
+
+    engine_t eng;               // engine shared by every program
+    y86_t cpu;                  // CPU every program starts with
+    byte_t *memory;             // address space every program starts with
+    y86_mem_t mem;              // page table every program starts with
+    uint64_t count;             // instruction count every program starts at
+    uint64_t maxInsns;          // instructions a program may retire (0 for no limit)
+
+    sched_vm_t *head;           // programs ready to run, in order
+    sched_vm_t *tail;
+    sched_vm_t *cur;            // program running on the engine
+    sched_vm_t *all;            // every program being served
+
+    uint64_t live;              // programs being served
+    uint64_t peak;              //   at most at once
+    uint64_t served;            // programs started
+
+} sched_t;
+
+/**
+ * @brief Prepare to serve copies of a loaded program
+ *
+ * The program's pages are marked as holding decoded code in the current
+ * page table, which every served program starts with a copy of.
+ *
+ * @param sch Pointer to the scheduler
+ * @param cpu CPU every program starts with
+ * @param memory Loaded address space (kept, not copied, until sched_free)
+ * @param prog Decoded program, or NULL
+ * @param count Instruction count every program starts at
+ * @param maxInsns Instructions a program may retire before its connection
+ * is closed (0 for no limit)
+ */
+void sched_init (sched_t *sch, y86_t *cpu, byte_t *memory, y86_decoded_t *prog,
+                 uint64_t count, uint64_t maxInsns);
+
+/**
+ * @brief Listen for connections
+ *
+ * @param sch Pointer to the scheduler
+ * @param where Port number or socket path (see io_listen)
+ * @returns True if the socket is listening, false otherwise
+ */
+bool sched_listen (sched_t *sch, const char *where);
+
+/**
+ * @brief Start a copy of the program on every connection until SIGINT or
+ * SIGTERM
+ *
+ * Each connection is the standard input and output of its program: the
+ * input traps take what it sent, blocking only their own program, and
+ * FLUSH writes to it. The connection is closed when the program stops.
+ * Ready programs take turns of SCHED_QUANTUM instructions, with a look at
+ * epoll after each; a program its connection woke up goes first, so
+ * interactive programs answer without waiting for every busy one. When
+ * none is ready, the thread sleeps in epoll.
+ *
+ * @param sch Pointer to the listening scheduler
+ */
+void sched_serve (sched_t *sch);
+
+/**
+ * @brief Close every connection and the sockets of the scheduler
+ *
+ * @param sch Pointer to the scheduler
+ */
+void sched_free (sched_t *sch);
+
+#endif
@@ -0,0 +1,118 @@
+#!/bin/bash
+#
+# Integration checks for the execution options: exit codes, record and
+# replay, checkpoint and restore, the image cache and -t
+#
+# Name: Griffin Moran
+#
+
+cd "$(dirname "$0")"
+
+Y86=../y86
+IN=inputs
+OUT=outputs
+
+passed=0
+failed=0
+
+rm -rf $OUT
+mkdir -p $OUT
+
+#
+# Report one check: its name and whether the preceding test succeeded
+#
+check() {
+    if [ "$2" -eq 0 ]; then
+        passed=$((passed + 1))
+        echo "PASS $1"
+    else
+        failed=$((failed + 1))
+        echo "FAIL $1"
+    fi
+}
+
+#
+# Run y86 with the given arguments, stdin from /dev/null, and check its
+# exit status
+#
+status() {
+    local name=$1 want=$2
+    shift 2
+    $Y86 "$@" < /dev/null > $OUT/$name.out 2>&1
+    local got=$?
+    [ $got -eq $want ] || echo "  expected exit $want, got $got"
+    check "$name" $([ $got -eq $want ]; echo $?)
+}
+
+#
+# Check that the output of a run, minus its first line (which says where
+# execution began), matches another
+#
+same_tail() {
+    cmp -s <(tail -n +2 "$2") <(tail -n +2 "$3")
+    check "$1" $?
+}
+
+# exit codes
+status exit-halt 0 -e $IN/fact.o
+status exit-max-insns 2 -e --max-insns 1000 $IN/spin.o
+status exit-max-insns-t 2 -t --max-insns 1000 $IN/spin.o
+status exit-timeout 3 -e --timeout 0.2 $IN/spin.o
+status exit-break 4 -e --break 0x13f $IN/fact.o
+status exit-watch 4 -e --watch 0x600 $IN/fact.o
+grep -q "Stopped after 1000 instructions (--max-insns)" $OUT/exit-max-insns.out
+check exit-max-insns-message $?
+
+# a program blocked on input must still stop at the deadline
+sleep 2 | timeout 1 $Y86 -e --timeout 0.2 $IN/io.o > $OUT/exit-timeout-io.out 2>&1
+check exit-timeout-io $([ $? -eq 3 ]; echo $?)
+
+# record and replay
+echo "5 6 z" | $Y86 -e --record $OUT/io.tape $IN/io.o > $OUT/record.out
+$Y86 -e --replay $OUT/io.tape $IN/io.o < /dev/null > $OUT/replay.out
+cmp -s $OUT/record.out $OUT/replay.out
+check record-replay $?
+$Y86 -t --replay $OUT/io.tape $IN/io.o < /dev/null > $OUT/replay-t.out
+cmp -s $OUT/record.out $OUT/replay-t.out
+check record-replay-t $?
+
+# checkpoint and restore
+$Y86 -e --checkpoint $OUT/fact.ckpt --checkpoint-every 100 $IN/fact.o \
+    > $OUT/checkpoint.out
+check checkpoint-written $([ -s $OUT/fact.ckpt ]; echo $?)
+$Y86 -e --restore $OUT/fact.ckpt $IN/fact.o > $OUT/restore.out
+same_tail checkpoint-restore $OUT/checkpoint.out $OUT/restore.out
+grep -q "^Resuming execution at" $OUT/restore.out
+check restore-resumes $?
+
+# the image cache: a miss, then a hit, then a corrupted entry
+$Y86 -e $IN/fact.o > $OUT/plain.out
+$Y86 -e -C $OUT/cache $IN/fact.o > $OUT/cache-miss.out
+cmp -s $OUT/plain.out $OUT/cache-miss.out
+check cache-miss $?
+check cache-entry $([ -n "$(ls $OUT/cache)" ]; echo $?)
+$Y86 -e -C $OUT/cache $IN/fact.o > $OUT/cache-hit.out
+cmp -s $OUT/plain.out $OUT/cache-hit.out
+check cache-hit $?
+for entry in $OUT/cache/*; do
+    printf '\377\377\377\377' | dd of="$entry" bs=1 seek=64 conv=notrunc \
+        2> /dev/null
+done
+$Y86 -e -C $OUT/cache $IN/fact.o > $OUT/cache-corrupt.out
+cmp -s $OUT/plain.out $OUT/cache-corrupt.out
+check cache-corrupt $?
+
+# -t agrees with the reference interpreter
+for prog in fact loop smc; do
+    $Y86 -t $IN/$prog.o > $OUT/t-$prog.out 2>&1
+    check t-$prog $(! grep -q Divergence $OUT/t-$prog.out; echo $?)
+done
+echo "5 6 z" | $Y86 -t $IN/io.o > $OUT/t-io.out 2>&1
+cmp -s $OUT/record.out $OUT/t-io.out
+check t-io $?
+$Y86 -X -t $IN/xcross.o > $OUT/t-xcross.out 2>&1
+grep -q ADR $OUT/t-xcross.out && ! grep -q Divergence $OUT/t-xcross.out
+check t-xcross $?
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
@@ -6,6 +6,9 @@
 
 #define VADDRBITS 12
 #define MEMSIZE (1 << VADDRBITS)
+#define PAGEBITS 6
+#define PAGESIZE (1 << PAGEBITS)
+#define NUMPAGES (MEMSIZE >> PAGEBITS)
 #define NUMREGS 15
 
 /* type declarations */